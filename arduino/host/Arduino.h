@@ -0,0 +1,121 @@
+// Host build of the Arduino core, just enough of it for main.cpp. See firmware_host.cpp
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+
+typedef uint8_t byte;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define DEC 10
+#define HEX 16
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+long map(long x, long inMin, long inMax, long outMin, long outMax);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+
+bool psramFound();
+void* ps_malloc(size_t size);
+
+class String {
+ public:
+  String() {}
+  String(const char* value) : s(value ? value : "") {}
+  String(const std::string& value) : s(value) {}
+  String(char value) : s(1, value) {}
+  String(int value) : s(std::to_string(value)) {}
+  String(unsigned int value) : s(std::to_string(value)) {}
+  String(long value) : s(std::to_string(value)) {}
+  String(unsigned long value) : s(std::to_string(value)) {}
+
+  unsigned int length() const { return s.size(); }
+  const char* c_str() const { return s.c_str(); }
+  char charAt(unsigned int index) const { return index < s.size() ? s[index] : 0; }
+  char operator[](unsigned int index) const { return charAt(index); }
+
+  int indexOf(char c, unsigned int from = 0) const { return position(s.find(c, from)); }
+  int indexOf(const char* value) const { return position(s.find(value)); }
+  int lastIndexOf(char c) const { return position(s.rfind(c)); }
+  bool startsWith(const char* prefix) const { return s.rfind(prefix, 0) == 0; }
+  bool equalsIgnoreCase(const char* other) const;
+
+  String substring(unsigned int from) const { return from >= s.size() ? String() : String(s.substr(from)); }
+  String substring(unsigned int from, unsigned int to) const {
+    return from >= s.size() || to <= from ? String() : String(s.substr(from, to - from));
+  }
+
+  void trim();
+  void remove(unsigned int index, unsigned int count) { if (index < s.size()) s.erase(index, count); }
+  void reserve(unsigned int size) { s.reserve(size); }
+
+  String& operator+=(const String& other) { s += other.s; return *this; }
+  String& operator+=(const char* other) { s += other; return *this; }
+  String& operator+=(char c) { s += c; return *this; }
+  bool operator==(const char* other) const { return s == other; }
+
+  friend String operator+(const String& a, const String& b) { return String(a.s + b.s); }
+  friend String operator+(const char* a, const String& b) { return String(std::string(a) + b.s); }
+  friend String operator+(const String& a, const char* b) { return String(a.s + b); }
+
+ private:
+  static int position(size_t found) { return found == std::string::npos ? -1 : (int)found; }
+
+  std::string s;
+};
+
+class Print {
+ public:
+  virtual ~Print() {}
+  virtual size_t write(const uint8_t* buffer, size_t size) = 0;
+
+  size_t write(uint8_t value) { return write(&value, 1); }
+  size_t print(const char* value) { return write((const uint8_t*)value, strlen(value)); }
+  size_t print(const String& value) { return print(value.c_str()); }
+  size_t print(char value) { return write((uint8_t)value); }
+  size_t print(int value) { return print(String(value)); }
+  size_t print(unsigned int value, int base = DEC);
+  size_t print(long value) { return print(String(value)); }
+  size_t print(unsigned long value) { return print(String(value)); }
+
+  size_t println() { return print("\r\n"); }
+  size_t println(unsigned int value, int base) { return print(value, base) + println(); }
+  template <typename T> size_t println(T value) { return print(value) + println(); }
+};
+
+// The firmware's serial port, backed by a file descriptor (a pty's master side when run by deej's harness).
+// Received bytes are read by hostPoll(), which runs from delay() and yield() like the ESP32's serial event task
+class HardwareSerial : public Print {
+ public:
+  void setRxBufferSize(size_t size);
+  void begin(unsigned long baud);
+  void onReceive(void (*callback)(), bool onlyOnTimeout = false);
+  int available();
+  int read();
+  int availableForWrite();
+  size_t write(const uint8_t* buffer, size_t size) override;
+  using Print::write;
+  operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
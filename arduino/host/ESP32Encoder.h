@@ -0,0 +1,19 @@
+// Host build of the PCNT encoder driver. Counts only change through the harness' scripted input
+#pragma once
+
+#include <Arduino.h>
+
+enum puType { UP, DOWN, NONE, up = UP, down = DOWN, none = NONE };
+
+class ESP32Encoder {
+ public:
+  static puType useInternalWeakPullResistors;
+
+  void attachHalfQuad(int pinA, int pinB) {}
+  void clearCount() { count = 0; }
+  void setCount(int64_t value) { count = value; }
+  int64_t getCount() { return count; }
+
+ private:
+  int64_t count = 0;
+};
@@ -0,0 +1,12 @@
+// Host build of the interrupt driven encoder. Counts only change through the harness' scripted input
+#pragma once
+
+#include <Arduino.h>
+
+class InterruptEncoder {
+ public:
+  volatile int64_t count = 0;
+
+  void attach(int pinA, int pinB) {}
+  int64_t read() { return count; }
+};
@@ -0,0 +1,14 @@
+// Host build of the I2C driver. Transmissions go nowhere, and always succeed
+#pragma once
+
+#include <Arduino.h>
+
+class TwoWire {
+ public:
+  bool begin(int sda, int scl, uint32_t frequency = 0);
+  void beginTransmission(uint8_t address);
+  size_t write(uint8_t value);
+  uint8_t endTransmission(bool sendStop = true);
+};
+
+extern TwoWire Wire;
@@ -0,0 +1,361 @@
+// Runs the firmware (main.cpp, unchanged) as a Linux program, for deej's firmware-in-the-loop harness.
+//
+//   deej-firmware-host <serial fd>
+//
+// The serial port is an inherited file descriptor, deej passes the master side of a pty as fd 3. Peripherals are
+// stubbed: I2C writes go nowhere, PSRAM is the heap, and inputs only change through scripted input on stdin,
+// one command per line:
+//
+//   turn <e1-e6> <detents>    turn an encoder (positive detents raise the volume)
+//   press <b1-b4|e1-e6>       press a dome button or an encoder's push switch
+//   release <b1-b4|e1-e6>     release it again
+//   reboot <ms>               go silent for ms, then come back like after a power cycle: uptime starts over,
+//                             every knob is at zero and whatever deej sent meanwhile is gone
+//
+// The program exits when stdin closes, or when the other side of the serial port goes away.
+// Build it with pkg/deej/scripts/linux/build-firmware-host.sh
+
+#include "../src/main.cpp"
+
+#include <errno.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <deque>
+#include <vector>
+
+// --- Host State ---
+const int HOST_PIN_COUNT = 64;
+const size_t HOST_CONTROL_LINE_MAX_LENGTH = 64;
+
+HardwareSerial Serial;
+TwoWire Wire;
+puType ESP32Encoder::useInternalWeakPullResistors = puType::up;
+
+int hostSerialFd = -1;
+std::deque<uint8_t> hostSerialRx;
+size_t hostSerialRxCapacity = 256;
+void (*hostSerialCallback)() = nullptr;
+
+uint8_t hostPinLevels[HOST_PIN_COUNT];
+std::string hostControlLine;
+struct timespec hostStartTime;
+
+// --- Time ---
+uint64_t hostElapsedMicros() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)(now.tv_sec - hostStartTime.tv_sec) * 1000000ULL + (now.tv_nsec - hostStartTime.tv_nsec) / 1000;
+}
+
+unsigned long micros() {
+  return (unsigned long)hostElapsedMicros();
+}
+
+unsigned long millis() {
+  return (unsigned long)(hostElapsedMicros() / 1000);
+}
+
+// --- Scripted Input ---
+// Finds the pin behind a source name (b1-b4, e1-e6), or returns -1
+int hostSourcePin(const std::string& source) {
+  if (source.size() < 2) {
+    return -1;
+  }
+  int number = atoi(source.c_str() + 1);
+  if (source[0] == 'b' && number >= 1 && number <= numButtons) {
+    return buttons[number - 1].pin;
+  }
+  if (source[0] == 'e' && number >= 1 && number <= numEncoders) {
+    return encoders[number - 1].btn_pin;
+  }
+  return -1;
+}
+
+void hostTurnEncoder(const std::string& source, long detents) {
+  int number = source.size() >= 2 && source[0] == 'e' ? atoi(source.c_str() + 1) : 0;
+  if (number < 1 || number > numEncoders) {
+    fprintf(stderr, "firmware host: unknown encoder %s\n", source.c_str());
+    return;
+  }
+
+  // Counts go down as volume goes up, and both drivers count two steps per detent
+  EncoderInfo& encoder = encoders[number - 1];
+  if (encoder.useHardwareAccel) {
+    encoder.hardwareDriver.setCount(encoder.hardwareDriver.getCount() - detents * 2);
+  } else {
+    encoder.driver.count = encoder.driver.count - detents * 2;
+  }
+}
+
+void hostReboot(long silentMillis) {
+  usleep((useconds_t)silentMillis * 1000);
+  tcflush(hostSerialFd, TCIFLUSH);
+  hostSerialRx.clear();
+  serialRxLineLength = 0;
+  SerialLine dropped;
+  while (xQueueReceive(serialLineQueue, &dropped, 0) == pdTRUE) {
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &hostStartTime);
+  for (int i = 0; i < numEncoders; i++) {
+    encoders[i].setRawCount(0); // The next scan reports them, like setup() does
+  }
+  lastEncoderReportMillis = 0;
+  startScheduler();
+}
+
+void hostHandleControlLine(const std::string& line) {
+  char command[16];
+  char source[16];
+  long amount = 0;
+
+  int fields = sscanf(line.c_str(), "%15s %15s %ld", command, source, &amount);
+  if (fields < 2) {
+    return;
+  }
+
+  std::string name(command);
+  if (name == "reboot") {
+    hostReboot(atol(source));
+    return;
+  }
+  if (name == "turn" && fields == 3) {
+    hostTurnEncoder(source, amount);
+    return;
+  }
+
+  int pin = hostSourcePin(source);
+  if (pin < 0) {
+    fprintf(stderr, "firmware host: unknown input %s\n", source);
+    return;
+  }
+
+  if (name == "press") {
+    hostPinLevels[pin] = LOW;
+  } else if (name == "release") {
+    hostPinLevels[pin] = HIGH;
+  } else {
+    fprintf(stderr, "firmware host: unknown command %s\n", command);
+  }
+}
+
+void hostReadControl() {
+  char buffer[256];
+  ssize_t n = read(STDIN_FILENO, buffer, sizeof(buffer));
+  if (n == 0) {
+    exit(0);
+  }
+  if (n < 0) {
+    return;
+  }
+
+  for (ssize_t i = 0; i < n; i++) {
+    if (buffer[i] == '\n') {
+      hostHandleControlLine(hostControlLine);
+      hostControlLine.clear();
+    } else if (hostControlLine.size() < HOST_CONTROL_LINE_MAX_LENGTH) {
+      hostControlLine += buffer[i];
+    }
+  }
+}
+
+// --- Serial ---
+// Reads whatever arrived into the RX buffer and runs the receive callback, like the serial event task would
+void hostReadSerial() {
+  uint8_t buffer[1024];
+  ssize_t n = read(hostSerialFd, buffer, sizeof(buffer));
+  if (n == 0 || (n < 0 && errno == EIO)) {
+    exit(0); // Nobody on the other side anymore
+  }
+  if (n < 0) {
+    return;
+  }
+
+  for (ssize_t i = 0; i < n; i++) {
+    if (hostSerialRx.size() < hostSerialRxCapacity) {
+      hostSerialRx.push_back(buffer[i]); // A full RX buffer drops bytes, like the UART driver does
+    }
+  }
+
+  if (hostSerialCallback != nullptr) {
+    hostSerialCallback();
+  }
+}
+
+// Waits up to timeoutMillis for serial data or scripted input, and handles whatever arrives
+void hostPoll(int timeoutMillis) {
+  struct pollfd fds[2] = {{hostSerialFd, POLLIN, 0}, {STDIN_FILENO, POLLIN, 0}};
+  if (poll(fds, 2, timeoutMillis) <= 0) {
+    return;
+  }
+
+  if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+    hostReadSerial();
+  }
+  if (fds[1].revents & (POLLIN | POLLHUP | POLLERR)) {
+    hostReadControl();
+  }
+}
+
+void delay(unsigned long ms) {
+  uint64_t until = hostElapsedMicros() + (uint64_t)ms * 1000;
+  for (uint64_t now = hostElapsedMicros(); now < until; now = hostElapsedMicros()) {
+    hostPoll((int)((until - now + 999) / 1000));
+  }
+}
+
+void yield() {
+  hostPoll(0);
+}
+
+void HardwareSerial::setRxBufferSize(size_t size) {
+  hostSerialRxCapacity = size;
+}
+
+void HardwareSerial::begin(unsigned long baud) {}
+
+void HardwareSerial::onReceive(void (*callback)(), bool onlyOnTimeout) {
+  hostSerialCallback = callback;
+}
+
+int HardwareSerial::available() {
+  return (int)hostSerialRx.size();
+}
+
+int HardwareSerial::read() {
+  if (hostSerialRx.empty()) {
+    return -1;
+  }
+  uint8_t value = hostSerialRx.front();
+  hostSerialRx.pop_front();
+  return value;
+}
+
+int HardwareSerial::availableForWrite() {
+  return 4096;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+  size_t written = 0;
+  while (written < size) {
+    ssize_t n = ::write(hostSerialFd, buffer + written, size - written);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      exit(0);
+    }
+    written += n;
+  }
+  return size;
+}
+
+size_t Print::print(unsigned int value, int base) {
+  char buffer[16];
+  snprintf(buffer, sizeof(buffer), base == HEX ? "%X" : "%u", value);
+  return print(buffer);
+}
+
+// --- Arduino Core ---
+long map(long x, long inMin, long inMax, long outMin, long outMax) {
+  return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+
+int digitalRead(uint8_t pin) {
+  return pin < HOST_PIN_COUNT ? hostPinLevels[pin] : HIGH;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {}
+
+bool psramFound() {
+  return true;
+}
+
+void* ps_malloc(size_t size) {
+  return malloc(size);
+}
+
+bool String::equalsIgnoreCase(const char* other) const {
+  return strcasecmp(s.c_str(), other) == 0;
+}
+
+void String::trim() {
+  size_t first = s.find_first_not_of(" \t\r\n");
+  if (first == std::string::npos) {
+    s.clear();
+    return;
+  }
+  s = s.substr(first, s.find_last_not_of(" \t\r\n") - first + 1);
+}
+
+bool TwoWire::begin(int sda, int scl, uint32_t frequency) {
+  return true;
+}
+
+void TwoWire::beginTransmission(uint8_t address) {}
+
+size_t TwoWire::write(uint8_t value) {
+  return 1;
+}
+
+uint8_t TwoWire::endTransmission(bool sendStop) {
+  return 0;
+}
+
+// --- FreeRTOS Queues ---
+struct HostQueue {
+  size_t length;
+  size_t itemSize;
+  std::deque<std::vector<uint8_t>> items;
+};
+
+QueueHandle_t xQueueCreate(uint32_t length, uint32_t itemSize) {
+  return new HostQueue{length, itemSize, {}};
+}
+
+BaseType_t xQueueSend(QueueHandle_t handle, const void* item, TickType_t ticksToWait) {
+  HostQueue* queue = (HostQueue*)handle;
+  if (queue->items.size() >= queue->length) {
+    return pdFALSE;
+  }
+  const uint8_t* bytes = (const uint8_t*)item;
+  queue->items.emplace_back(bytes, bytes + queue->itemSize);
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t handle, void* item, TickType_t ticksToWait) {
+  HostQueue* queue = (HostQueue*)handle;
+  if (queue->items.empty()) {
+    return pdFALSE;
+  }
+  memcpy(item, queue->items.front().data(), queue->itemSize);
+  queue->items.pop_front();
+  return pdTRUE;
+}
+
+uint32_t uxQueueMessagesWaiting(QueueHandle_t handle) {
+  return ((HostQueue*)handle)->items.size();
+}
+
+// --- Entry Point ---
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s <serial fd>\n", argv[0]);
+    return 2;
+  }
+
+  hostSerialFd = atoi(argv[1]);
+  clock_gettime(CLOCK_MONOTONIC, &hostStartTime);
+  memset(hostPinLevels, HIGH, sizeof(hostPinLevels)); // Every input has a pull-up
+
+  setup();
+  for (;;) {
+    yield();
+    loop();
+  }
+}
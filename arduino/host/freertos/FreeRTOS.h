@@ -0,0 +1,11 @@
+// Host build of the FreeRTOS types main.cpp uses
+#pragma once
+
+#include <stdint.h>
+
+typedef void* QueueHandle_t;
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
@@ -0,0 +1,9 @@
+// Host build of FreeRTOS queues. The host build is single threaded, so these don't lock
+#pragma once
+
+#include "FreeRTOS.h"
+
+QueueHandle_t xQueueCreate(uint32_t length, uint32_t itemSize);
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticksToWait);
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticksToWait);
+uint32_t uxQueueMessagesWaiting(QueueHandle_t queue);
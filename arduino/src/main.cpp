@@ -3,15 +3,34 @@
 #include <InterruptEncoder.h>
 #include <ESP32Encoder.h>
 #include <stdlib.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
 
 
 // --- System Configuration ---
 const unsigned long DEBOUNCE_DELAY = 50;
 const int MAX_ENCODER_VALUE = 100; // Increased for more granular control (0-100%)
 const float ENCODER_VOLUME_PER_COUNT = 2.0f; // Volume percent change per encoder detent (adjust for sensitivity)
+const unsigned long ENCODER_REPORT_KEEPALIVE_MS = 250; // Encoder values are reported on change, and at least this often
+const unsigned long ENCODER_REPORT_MIN_INTERVAL_MS = 10; // Only back-to-back reports wait, so a fast turn can't flood the link
+bool encoderReportPending = true;
+unsigned long lastEncoderReportMillis = 0;
 // --- Serial Communication ---
 const long SERIAL_BAUD_RATE = 9600;
-String serialBuffer = "";
+// Input is assembled into lines by the RX event callback, outside of loop(), and queued for the parser.
+// The enlarged RX buffer absorbs host bursts while the callback is busy
+const size_t SERIAL_RX_BUFFER_SIZE = 4096;
+const size_t SERIAL_LINE_MAX_LENGTH = 96;
+const int SERIAL_LINE_QUEUE_DEPTH = 32;
+
+struct SerialLine {
+  char text[SERIAL_LINE_MAX_LENGTH];
+  uint32_t receivedMicros; // When the RX callback queued it
+};
+QueueHandle_t serialLineQueue = nullptr;
+char serialRxLine[SERIAL_LINE_MAX_LENGTH];
+size_t serialRxLineLength = 0;
+bool serialRxLineOverflow = false;
 
 // --- LED Hardware & Color Definitions ---
 struct Color { byte r, g, b; };
@@ -45,6 +64,89 @@ BackgroundMode backgroundMode = BG_SOLID;
 Color backgroundSolidColor = {0, 50, 0};
 int rainbowHue = 0;
 
+// --- LED Frame Buffer ---
+// LED updates only change this buffer. The flush stage sends changed LEDs over I2C: ring and button LEDs always,
+// then the backlight for as long as the frame's bus-time budget lasts. Backlight LEDs that don't fit wait for
+// the next frame, so a busy bus slows the backlight animation down instead of delaying knob feedback
+enum LedPriority : uint8_t { LED_PRIORITY_INTERACTIVE = 0, LED_PRIORITY_AMBIENT = 1 };
+const int NUM_LED_PRIORITIES = 2;
+const unsigned long LED_FLUSH_BUDGET_MICROS = 2000;
+Color ledTarget[TOTAL_LEDS];
+Color ledShown[TOTAL_LEDS];
+bool ledDirty[TOTAL_LEDS];
+int dirtyLedCount[NUM_LED_PRIORITIES] = {0, 0};
+int ambientFlushCursor = 0;
+
+// --- Boot Timing ---
+// Microseconds since reset at which serial was up, the first encoder report went out and the LEDs were ready
+unsigned long bootSerialReadyMicros = 0;
+unsigned long bootFirstReportMicros = 0;
+unsigned long bootLedsReadyMicros = 0;
+
+// --- PSRAM Trace & Asset Storage ---
+// Everything here lives in PSRAM, and is simply unavailable on boards without it. Internal SRAM stays for the hot path
+enum TraceType : uint8_t {
+  TRACE_ENCODER = 1, // a: encoder, c: position
+  TRACE_MUTE = 2,    // a: encoder, c: muted
+  TRACE_BUTTON = 3,  // a: button
+  TRACE_COMMAND = 4, // a: command ID, c: payload length
+  TRACE_I2C = 5,     // a: chip address, b: register, c: duration micros << 8 | endTransmission status
+  TRACE_STAGE = 6,   // a: stage, b: deadline missed, c: runtime micros
+  TRACE_GESTURE = 7  // a: gesture kind ('l', 'd', 't', 'c'), b: source mask, c: turn detents
+};
+
+struct TraceEvent {
+  uint32_t micros;
+  uint8_t type;
+  uint8_t a;
+  uint16_t b;
+  uint32_t c;
+};
+
+const uint32_t TRACE_CAPACITY = 262144; // 3 MB, minutes of history
+const int TRACE_DUMP_EVENTS_PER_LINE = 8;
+const int TRACE_DUMP_LINES_PER_RUN = 4;
+TraceEvent* traceEvents = nullptr;
+uint32_t traceHead = 0; // Total events ever recorded, the next one goes to traceHead % TRACE_CAPACITY
+bool traceDumpActive = false;
+uint32_t traceDumpCursor = 0;
+uint32_t traceDumpEnd = 0;
+uint32_t traceDumpSent = 0;
+uint32_t traceDumpOverwritten = 0;
+
+// Bulk assets (animations, profiles), each slot one PSRAM buffer that grows as needed
+const int NUM_ASSET_SLOTS = 8;
+struct AssetSlot { uint8_t* data; size_t size; size_t capacity; };
+AssetSlot assetSlots[NUM_ASSET_SLOTS];
+
+// --- Keyframe Animations ---
+// Uploaded by deej and played from the LED stage without any further serial traffic. Keyframes live in the
+// asset slot of the same number. Always-on animations play from the moment they're defined, triggered ones
+// restart on their button press or mute toggle (a looping one toggles instead)
+enum AnimationTrigger : uint8_t { TRIGGER_ALWAYS = 0, TRIGGER_BUTTON = 1, TRIGGER_MUTE = 2 };
+const uint8_t TRIGGER_ANY_INDEX = 0xFF;
+const int NUM_ANIMATIONS = 4;
+const int MAX_ANIMATION_KEYFRAMES = 64;
+
+struct __attribute__((packed)) Keyframe {
+  uint16_t atMillis;
+  Color color;
+};
+
+struct Animation {
+  bool defined;
+  int firstLed, lastLed;
+  AnimationTrigger trigger;
+  uint8_t triggerIndex;
+  bool loop;
+  uint16_t keyframeCount;
+  bool playing;
+  unsigned long startMillis;
+  uint32_t hash; // FNV-1a over the accepted definition and keyframe payloads, each followed by a newline
+};
+
+Animation animations[NUM_ANIMATIONS];
+
 const Color BUTTON_ACTIVE_COLOR = {50, 50, 50};
 const Color BUTTON_INACTIVE_COLOR = {0, 0, 0};
 
@@ -67,6 +169,7 @@ struct EncoderInfo {
   long lastDetentPosition;
   bool isPressed;
   bool isMuted; // For toggle functionality
+  bool mutePending; // Tapped, waiting out DOUBLE_PRESS_MS before toggling
   uint8_t lastButtonState;
   unsigned long lastDebounceTime;
   Color zeroColor;
@@ -77,6 +180,7 @@ struct EncoderInfo {
       lastDetentPosition = 0;
       isPressed = false;
       isMuted = false;
+      mutePending = false;
       lastButtonState = HIGH;
       lastDebounceTime = 0;
       zeroColor = {50, 0, 0}; // Default Red
@@ -105,7 +209,7 @@ struct EncoderInfo {
     if (useHardwareAccel) {
       hardwareDriver.setCount((int64_t)value * 2);
     } else {
-      driver.count = value;
+      driver.count = (int64_t)value * 2;
     }
   }
 };
@@ -126,6 +230,28 @@ struct ButtonInfo {
   }
 };
 
+// --- Scheduler Stage ---
+struct Stage {
+  const char* name;
+  void (*run)();
+  unsigned long periodMicros;
+  bool (*ready)(); // Optional, a due stage only runs when this returns true
+  unsigned long nextDueMicros;
+  unsigned long runs;
+  unsigned long totalMicros;
+  unsigned long maxMicros;
+  unsigned long deadlineMisses;
+
+  Stage(const char* n, void (*r)(), unsigned long period, bool (*isReady)() = nullptr) :
+    name(n), run(r), periodMicros(period), ready(isReady) {
+      nextDueMicros = 0;
+      runs = 0;
+      totalMicros = 0;
+      maxMicros = 0;
+      deadlineMisses = 0;
+  }
+};
+
 // --- Input Device Definitions ---
 const uint8_t SDA_PIN = 8;
 const uint8_t SCL_PIN = 9;
@@ -150,16 +276,79 @@ const int numButtons = sizeof(buttons) / sizeof(ButtonInfo);
 const int NUM_BUTTON_GROUPS = 2;
 int selectedOutputIndexByGroup[NUM_BUTTON_GROUPS] = {-1, -1};
 
+// --- Gestures ---
+// Recognized on the device from the debounced edges, and sent to the host as one line once complete:
+//   G:long:<src>         held for LONG_PRESS_MS, without turning or other inputs
+//   G:double:<src>       pressed again within DOUBLE_PRESS_MS of the previous press' release
+//   G:turn:<src>:<+/-n>  encoder turned n detents while held, sent on release
+//   G:chord:<src>+<src>  inputs held down together, sent once the last of them is released
+// Sources are b1-b4 for the dome buttons and e1-e6 for the encoder push switches. Encoders mute once a plain press
+// is released and DOUBLE_PRESS_MS pass without a second one, so a double press never touches mute, and turning while
+// held doesn't change volume. Dome buttons still select their output on the press edge
+const unsigned long LONG_PRESS_MS = 500;
+const unsigned long DOUBLE_PRESS_MS = 300;
+const int GESTURE_ENCODER_BIT = 8; // Source mask: dome buttons are bits 0-7, encoders 8-15
+enum TapResult : uint8_t { TAP_NONE, TAP_SINGLE, TAP_DOUBLE };
+
+struct GestureState {
+  bool held;
+  bool consumed; // Long press, turn or chord, the release isn't a tap
+  unsigned long pressedAt;
+  unsigned long lastTapAt; // Release of the previous tap, 0 when there's none to pair with
+  long pressCount; // Encoders: raw count when pressed, held there while turning
+  long turnDetents;
+};
+
+GestureState buttonGestures[numButtons];
+GestureState encoderGestures[numEncoders];
+uint16_t heldInputMask = 0;
+uint16_t chordInputMask = 0;
+
 // --- Function Prototypes ---
 void setSingleLedColor(int ledNum, const Color& c);
+void writeLedColor(int ledNum, const Color& c);
+void beginLeds();
+void* psramAlloc(size_t bytes);
+void psramFree(void* ptr);
+void beginTrace();
+void trace(TraceType type, uint8_t a, uint16_t b, uint32_t c);
+void startTraceDump(const String& payload);
+bool traceDumpPending();
+void sendTraceDump();
+uint8_t* assetReserve(int slot, size_t size);
+const uint8_t* assetData(int slot, size_t& size);
+void assetRelease(int slot);
+void sendBootTimings();
+bool ledsDirty();
+void flushLeds();
 void updateEncoderLedDisplay(int encoderIndex);
+void beginSerialInput();
+void drainSerialInput();
 void handleSerialCommands();
+void handleSerialCommand(const String& line, uint32_t receivedMicros);
 void sendEncoderValues();
+void startScheduler();
+void runScheduler();
+void scanInputs();
+void onInputPressed(int bit, unsigned long at);
+TapResult onInputReleased(int bit, unsigned long at);
+void checkLongPresses(unsigned long now);
+void toggleEncoderMute(int i);
+void sendStageTimings();
 void updateBackgroundLighting();
+void renderLighting();
+void defineAnimation(const String& payload);
+void addAnimationKeyframe(const String& payload);
+void triggerAnimations(AnimationTrigger trigger, uint8_t index);
+void renderAnimations();
+uint32_t animationStateHash();
 Color hexToColor(String hex);
 Color Wheel(byte WheelPos);
 bool parseIntStrict(const String& value, int& outValue);
 bool parseFloatStrict(const String& value, float& outValue);
+uint32_t backgroundStateHash();
+uint32_t colorStateHash();
+void sendStateDump();
 
 double encoderCountToVolume(long rawCount);
 long volumeToEncoderCount(double volume);
@@ -200,49 +389,175 @@ void applyOutputSelection(int index, bool notifySerial) {
     setSingleLedColor(buttons[i].ledNum, isSelected ? BUTTON_ACTIVE_COLOR : BUTTON_INACTIVE_COLOR);
   }
 
+  // O:index:group - deej runs one output command at a time per group, so it needs to know the group
   if (notifySerial && previousIndex != selectedOutputIndexByGroup[groupIndex]) {
     Serial.print("O:");
-    Serial.println(index + 1);
+    Serial.print(index + 1);
+    Serial.print(':');
+    Serial.println(groupIndex);
   }
 }
 
 
 // --- Main Setup ---
 void setup() {
-  Serial.begin(SERIAL_BAUD_RATE);
-  // Quick boot marker to verify serial baud and monitor readability
-  delay(50);
-  Serial.println("=== deej boot (Serial "+ String(SERIAL_BAUD_RATE) + ") ===");
-  Wire.begin(SDA_PIN, SCL_PIN);
+  beginSerialInput();
+  bootSerialReadyMicros = micros();
+  beginTrace();
 
   ESP32Encoder::useInternalWeakPullResistors = puType::up;
 
+  for (int i = 0; i < numEncoders; i++) {
+    encoders[i].beginEncoder();
+    encoders[i].setRawCount(0);
+    pinMode(encoders[i].btn_pin, INPUT_PULLUP);
+  }
+  for (int i = 0; i < numButtons; i++) { pinMode(buttons[i].pin, INPUT_PULLUP); }
+
+  // Knobs work from here on, so deej hears from us before any time is spent on the LEDs
+  sendEncoderValues();
+  bootFirstReportMicros = micros();
+
+  beginLeds();
+  for (int i = 0; i < numEncoders; i++) {
+    updateEncoderLedDisplay(i);
+  }
+  applyOutputSelection(0, true);
+  applyOutputSelection(2, true);
+  // The above only stages colors; they aren't lit until flushed, and one flush caps the backlight at its budget
+  while (ledsDirty()) {
+    flushLeds();
+  }
+  bootLedsReadyMicros = micros();
+
+  sendBootTimings();
+  startScheduler();
+}
+
+// Enables every LP50xx and clears its outputs with one auto-incrementing write per chip
+void beginLeds() {
+  Wire.begin(SDA_PIN, SCL_PIN);
+
   pinMode(MUX_SELECT_PIN, OUTPUT);
   for (int bank = 0; bank < 2; bank++) {
     digitalWrite(MUX_SELECT_PIN, bank == 0 ? LOW : HIGH);
     for (byte address : LED_CHIP_ADDRESSES) {
       Wire.beginTransmission(address); Wire.write(DEVICE_CONFIG0); Wire.write(0x40); Wire.endTransmission();
+
+      // Matches the frame buffer's initial state
+      Wire.beginTransmission(address);
+      Wire.write(OUT0_COLOR_ADDR);
+      for (int output = 0; output < LEDS_PER_CHIP * 3; output++) { Wire.write((byte)0); }
+      Wire.endTransmission();
     }
   }
   digitalWrite(MUX_SELECT_PIN, LOW);
+}
 
-  for(int i = 1; i <= TOTAL_LEDS; i++) { setSingleLedColor(i, {0,0,0}); }
+// Boot marker with the time (since reset) each boot phase finished at
+void sendBootTimings() {
+  Serial.println("=== deej boot (Serial " + String(SERIAL_BAUD_RATE) + "): serial " + String(bootSerialReadyMicros) +
+                 "us, first report " + String(bootFirstReportMicros) + "us, leds " + String(bootLedsReadyMicros) + "us ===");
+}
 
-  for (int i = 0; i < numEncoders; i++) {
-    encoders[i].beginEncoder();
-    encoders[i].setRawCount(0);
-    pinMode(encoders[i].btn_pin, INPUT_PULLUP);
-    updateEncoderLedDisplay(i);
+// --- Main Loop ---
+void loop() {
+  runScheduler();
+}
+
+// --- Scheduler ---
+// Stages are listed by priority. Each pass runs the first stage that is due, then starts over from the top,
+// so a due input scan never waits behind more than one lower priority stage.
+// A periodic stage that starts more than one period late counts a deadline miss and skips the runs it missed
+bool serialCommandsWaiting() {
+  return uxQueueMessagesWaiting(serialLineQueue) > 0;
+}
+
+// A change after a quiet spell goes out on the next pass, a stream of them at most every ENCODER_REPORT_MIN_INTERVAL_MS
+bool encoderReportDue() {
+  unsigned long sinceReport = millis() - lastEncoderReportMillis;
+  return (encoderReportPending && sinceReport >= ENCODER_REPORT_MIN_INTERVAL_MS) || sinceReport >= ENCODER_REPORT_KEEPALIVE_MS;
+}
+
+Stage stages[] = {
+  Stage("inputs", scanInputs, 1000),
+  Stage("serial", handleSerialCommands, 1000, serialCommandsWaiting),
+  Stage("flush", flushLeds, 4000, ledsDirty),
+  Stage("report", sendEncoderValues, 1000, encoderReportDue),
+  Stage("leds", renderLighting, 20000),
+  Stage("trace", sendTraceDump, 2000, traceDumpPending)
+};
+
+const int numStages = sizeof(stages) / sizeof(Stage);
+
+// Starts every stage's clock now, so the time spent in setup() doesn't count as missed deadlines
+void startScheduler() {
+  unsigned long now = micros();
+  for (int i = 0; i < numStages; i++) {
+    stages[i].nextDueMicros = now;
   }
-  for (int i = 0; i < numButtons; i++) { pinMode(buttons[i].pin, INPUT_PULLUP); }
+}
 
-  applyOutputSelection(0, true);
-  applyOutputSelection(2, true);
+void runScheduler() {
+  unsigned long now = micros();
+  unsigned long nextDue = now + 1000;
+
+  for (int i = 0; i < numStages; i++) {
+    Stage& stage = stages[i];
+    long untilDue = (long)(stage.nextDueMicros - now);
+    if (untilDue > 0) {
+      if ((long)(stage.nextDueMicros - nextDue) < 0) nextDue = stage.nextDueMicros;
+      continue;
+    }
+
+    bool missed = (unsigned long)(-untilDue) > stage.periodMicros;
+    if (missed) {
+      stage.deadlineMisses++;
+      stage.nextDueMicros = now;
+    }
+    stage.nextDueMicros += stage.periodMicros;
+
+    if (stage.ready != nullptr && !stage.ready()) {
+      continue;
+    }
+
+    stage.run();
+    unsigned long elapsed = micros() - now;
+    trace(TRACE_STAGE, i, missed, elapsed);
+    stage.runs++;
+    stage.totalMicros += elapsed;
+    if (elapsed > stage.maxMicros) stage.maxMicros = elapsed;
+    return;
+  }
+
+  // Nothing to do: sleep for a tick if the next stage allows it, so lower priority tasks get to run
+  if ((long)(nextDue - micros()) >= 1000) {
+    delay(1);
+  } else {
+    yield();
+  }
 }
 
-// --- Main Loop ---
-void loop() {
+// The boot marker, then one line per stage: T:name:runs:averageMicros:maxMicros:deadlineMisses
+void sendStageTimings() {
+  sendBootTimings();
+  for (int i = 0; i < numStages; i++) {
+    Stage& stage = stages[i];
+    Serial.print("T:");
+    Serial.print(stage.name);
+    Serial.print(':');
+    Serial.print(stage.runs);
+    Serial.print(':');
+    Serial.print(stage.runs > 0 ? stage.totalMicros / stage.runs : 0UL);
+    Serial.print(':');
+    Serial.print(stage.maxMicros);
+    Serial.print(':');
+    Serial.println(stage.deadlineMisses);
+  }
+}
 
+// --- Input Scanning ---
+void scanInputs() {
   // Check Rotary Encoders
   for (int i = 0; i < numEncoders; i++) {
     if (ENCODER_VOLUME_PER_COUNT <= 0.0f) {
@@ -250,6 +565,18 @@ void loop() {
     }
 
     long rawCount = encoders[i].getRawCount();
+
+    // Turning a held encoder is a gesture, the count stays where it was pressed so volume doesn't move
+    if (encoders[i].isPressed) {
+      GestureState& gesture = encoderGestures[i];
+      if (rawCount != gesture.pressCount) {
+        gesture.turnDetents += gesture.pressCount - rawCount; // Counts go down as volume goes up
+        gesture.consumed = true;
+        encoders[i].setRawCount(gesture.pressCount);
+      }
+      continue;
+    }
+
     double requestedVolume = encoderCountToVolume(rawCount);
     double clampedVolume = constrain(requestedVolume, 0.0, (double)MAX_ENCODER_VALUE);
 
@@ -261,39 +588,176 @@ void loop() {
 
     if (currentDetentPosition != encoders[i].lastDetentPosition) {
       encoders[i].lastDetentPosition = currentDetentPosition;
+      trace(TRACE_ENCODER, i, 0, currentDetentPosition);
       updateEncoderLedDisplay(i);
+      encoderReportPending = true;
     }
   }
 
-  // Check Encoder Buttons (no deej action, just local LED change)
+  // Check Encoder Buttons (mute toggles locally, gestures go to deej)
   for (int i = 0; i < numEncoders; i++) {
     int reading = digitalRead(encoders[i].btn_pin);
     if (reading != encoders[i].lastButtonState && millis() - encoders[i].lastDebounceTime > DEBOUNCE_DELAY) {
       encoders[i].lastDebounceTime = millis();
       encoders[i].lastButtonState = reading;
-      if (reading == LOW) { // Button pressed
-        encoders[i].isMuted = !encoders[i].isMuted;
-        updateEncoderLedDisplay(i);
+      encoders[i].isPressed = reading == LOW;
+
+      if (encoders[i].isPressed) {
+        encoderGestures[i].pressCount = encoders[i].getRawCount();
+        onInputPressed(GESTURE_ENCODER_BIT + i, encoders[i].lastDebounceTime);
+      } else {
+        TapResult tap = onInputReleased(GESTURE_ENCODER_BIT + i, encoders[i].lastDebounceTime);
+        if (tap == TAP_SINGLE) {
+          encoders[i].mutePending = true;
+        } else if (tap == TAP_DOUBLE) {
+          encoders[i].mutePending = false;
+        } else if (encoders[i].mutePending) {
+          toggleEncoderMute(i); // Second press became a long press or turn, the first was still a tap
+        }
       }
     }
+
+    const GestureState& gesture = encoderGestures[i];
+    unsigned long sinceTap = millis() - gesture.lastTapAt;
+    bool secondPressInWindow = encoders[i].isPressed && gesture.pressedAt - gesture.lastTapAt <= DOUBLE_PRESS_MS;
+    if (encoders[i].mutePending && sinceTap > DOUBLE_PRESS_MS && !secondPressInWindow) {
+      toggleEncoderMute(i);
+    }
   }
 
-  // Check Rubber Dome Buttons (no deej action)
+  // Check Rubber Dome Buttons (output selection, gestures go to deej)
   for (int i = 0; i < numButtons; i++) {
     int reading = digitalRead(buttons[i].pin);
     if (reading != buttons[i].lastState && millis() - buttons[i].lastDebounceTime > DEBOUNCE_DELAY) {
       buttons[i].lastDebounceTime = millis();
       buttons[i].lastState = reading;
       if (reading == LOW) {
+        trace(TRACE_BUTTON, i, 0, 0);
         applyOutputSelection(i, true);
+        triggerAnimations(TRIGGER_BUTTON, i);
+        onInputPressed(i, buttons[i].lastDebounceTime);
+      } else {
+        onInputReleased(i, buttons[i].lastDebounceTime);
       }
     }
   }
-  
-  handleSerialCommands();
-  updateBackgroundLighting();
-  sendEncoderValues();
-  delay(10);
+
+  checkLongPresses(millis());
+}
+
+void toggleEncoderMute(int i) {
+  encoders[i].mutePending = false;
+  encoders[i].isMuted = !encoders[i].isMuted;
+  trace(TRACE_MUTE, i, 0, encoders[i].isMuted);
+  updateEncoderLedDisplay(i);
+  triggerAnimations(TRIGGER_MUTE, i);
+  encoderReportPending = true;
+}
+
+// --- Gesture Recognition ---
+GestureState& gestureState(int bit) {
+  return bit >= GESTURE_ENCODER_BIT ? encoderGestures[bit - GESTURE_ENCODER_BIT] : buttonGestures[bit];
+}
+
+void printGestureSources(uint16_t mask) {
+  bool first = true;
+  for (int bit = 0; bit < 16; bit++) {
+    if (!(mask & (1 << bit))) {
+      continue;
+    }
+    if (!first) {
+      Serial.print('+');
+    }
+    Serial.print(bit >= GESTURE_ENCODER_BIT ? 'e' : 'b');
+    Serial.print(bit % GESTURE_ENCODER_BIT + 1);
+    first = false;
+  }
+}
+
+void sendGesture(const char* kind, uint16_t sources) {
+  Serial.print("G:");
+  Serial.print(kind);
+  Serial.print(':');
+  printGestureSources(sources);
+  Serial.println();
+  trace(TRACE_GESTURE, kind[0], sources, 0);
+}
+
+void sendTurnGesture(uint16_t source, long detents) {
+  Serial.print("G:turn:");
+  printGestureSources(source);
+  Serial.print(':');
+  if (detents > 0) {
+    Serial.print('+');
+  }
+  Serial.println(detents);
+  trace(TRACE_GESTURE, 't', source, (uint32_t)detents);
+}
+
+void onInputPressed(int bit, unsigned long at) {
+  GestureState& gesture = gestureState(bit);
+  gesture.held = true;
+  gesture.consumed = false;
+  gesture.pressedAt = at;
+  gesture.turnDetents = 0;
+
+  // Pressed while something else is held: everything held becomes one chord, and none of it counts on its own
+  if (heldInputMask != 0) {
+    chordInputMask |= heldInputMask | (1 << bit);
+    for (int other = 0; other < 16; other++) {
+      if (chordInputMask & (1 << other)) {
+        gestureState(other).consumed = true;
+      }
+    }
+  }
+  heldInputMask |= 1 << bit;
+}
+
+// Finishes the input's gesture, and returns whether the press was a tap (or the second tap of a double press)
+TapResult onInputReleased(int bit, unsigned long at) {
+  GestureState& gesture = gestureState(bit);
+  if (!gesture.held) {
+    return TAP_NONE; // Held since before boot
+  }
+  gesture.held = false;
+  heldInputMask &= ~(1 << bit);
+
+  if (gesture.turnDetents != 0 && !(chordInputMask & (1 << bit))) {
+    sendTurnGesture(1 << bit, gesture.turnDetents);
+  }
+
+  if (chordInputMask != 0 && heldInputMask == 0) {
+    sendGesture("chord", chordInputMask);
+    chordInputMask = 0;
+  }
+
+  if (gesture.consumed) {
+    gesture.lastTapAt = 0;
+    return TAP_NONE;
+  }
+
+  if (gesture.lastTapAt != 0 && gesture.pressedAt - gesture.lastTapAt <= DOUBLE_PRESS_MS) {
+    sendGesture("double", 1 << bit);
+    gesture.lastTapAt = 0;
+    return TAP_DOUBLE;
+  }
+
+  gesture.lastTapAt = at;
+  return TAP_SINGLE;
+}
+
+// Long presses are sent while still held, so they don't wait for the release
+void checkLongPresses(unsigned long now) {
+  for (int bit = 0; bit < 16; bit++) {
+    if (!(heldInputMask & (1 << bit))) {
+      continue;
+    }
+    GestureState& gesture = gestureState(bit);
+    if (!gesture.consumed && now - gesture.pressedAt >= LONG_PRESS_MS) {
+      gesture.consumed = true;
+      sendGesture("long", 1 << bit);
+    }
+  }
 }
 
 // --- Deej Communication ---
@@ -309,90 +773,243 @@ void sendEncoderValues() {
     }
   }
   Serial.println(builtString);
+  encoderReportPending = false;
+  lastEncoderReportMillis = millis();
 }
 
-void handleSerialCommands() {
+// RX event callback: USB-Serial/JTAG (HWCDC) when USB CDC is on boot, otherwise the UART driver's event task
+#if ARDUINO_USB_CDC_ON_BOOT && ARDUINO_USB_MODE
+void onSerialRxEvent(void* arg, esp_event_base_t base, int32_t id, void* data) {
+  drainSerialInput();
+}
+#endif
+
+void beginSerialInput() {
+  serialLineQueue = xQueueCreate(SERIAL_LINE_QUEUE_DEPTH, sizeof(SerialLine));
+
+  Serial.setRxBufferSize(SERIAL_RX_BUFFER_SIZE); // Must happen before begin()
+#if ARDUINO_USB_CDC_ON_BOOT && ARDUINO_USB_MODE
+  Serial.onEvent(ARDUINO_HW_CDC_RX_EVENT, onSerialRxEvent);
+  Serial.begin(SERIAL_BAUD_RATE);
+#else
+  Serial.begin(SERIAL_BAUD_RATE);
+  Serial.onReceive(drainSerialInput);
+#endif
+}
+
+// Splits incoming bytes into lines and queues every complete one. Runs in the serial driver's event task
+void drainSerialInput() {
   while (Serial.available() > 0) {
     char c = Serial.read();
     if (c == '\n') {
-      // Command format: "ID:Payload"
-      int colonPos = serialBuffer.indexOf(':');
-      if (colonPos > 0) {
-        char commandID = serialBuffer.charAt(0);
-  String payload = serialBuffer.substring(colonPos + 1);
+      if (!serialRxLineOverflow && serialRxLineLength > 0) {
+        SerialLine line;
+        memcpy(line.text, serialRxLine, serialRxLineLength);
+        line.text[serialRxLineLength] = '\0';
+        line.receivedMicros = micros();
+        xQueueSend(serialLineQueue, &line, 0); // With a full queue the loop is far behind, and the line is dropped
+      }
+      serialRxLineLength = 0;
+      serialRxLineOverflow = false;
+    } else if (c != '\r') {
+      if (serialRxLineLength < SERIAL_LINE_MAX_LENGTH - 1) {
+        serialRxLine[serialRxLineLength++] = c;
+      } else {
+        serialRxLineOverflow = true; // Nothing the host sends is this long, drop the whole line
+      }
+    }
+  }
+}
+
+// Handles every command line that arrived since the last loop
+void handleSerialCommands() {
+  SerialLine line;
+  while (xQueueReceive(serialLineQueue, &line, 0) == pdTRUE) {
+    handleSerialCommand(String(line.text), line.receivedMicros);
+  }
+}
+
+void handleSerialCommand(const String& line, uint32_t receivedMicros) {
+  // Command format: "ID:Payload"
+  int colonPos = line.indexOf(':');
+  if (colonPos <= 0) {
+    return;
+  }
+
+  char commandID = line.charAt(0);
+  String payload = line.substring(colonPos + 1);
   payload.trim();
-        
-        if (commandID == 'V') { // Volume update: V:encoderIndex:volume(0.0-1.0)
-          int secondColonPos = payload.indexOf(':');
-          if (secondColonPos > 0) {
-            String indexPart = payload.substring(0, secondColonPos);
-            String volumePart = payload.substring(secondColonPos + 1);
-            indexPart.trim();
-            volumePart.trim();
-            int encoderIndex = -1;
-            float volume = 0.0f;
-            if (parseIntStrict(indexPart, encoderIndex) &&
-                parseFloatStrict(volumePart, volume) &&
-                encoderIndex >= 0 && encoderIndex < numEncoders) {
-              float clampedVolume = constrain(volume, 0.0f, 1.0f);
-              long clampedPosition = (long)round(clampedVolume * MAX_ENCODER_VALUE);
-              clampedPosition = constrain(clampedPosition, 0L, (long)MAX_ENCODER_VALUE);
-
-              encoders[encoderIndex].lastDetentPosition = clampedPosition;
-              encoders[encoderIndex].setRawCount(volumeToEncoderCount(clampedPosition));
-              updateEncoderLedDisplay(encoderIndex);
-            }
-          }
-        } else if (commandID == 'C') { // Color update: C:encoderIndex:zeroHex:fullHex
-          int secondColonPos = payload.indexOf(':');
-          int thirdColonPos = payload.lastIndexOf(':');
-          if (secondColonPos > 0 && thirdColonPos > secondColonPos) {
-            String encoderPart = payload.substring(0, secondColonPos);
-            encoderPart.trim();
-            int encoderIndex = -1;
-            String zeroHex = payload.substring(secondColonPos + 1, thirdColonPos);
-            String fullHex = payload.substring(thirdColonPos + 1);
-            zeroHex.trim();
-            fullHex.trim();
-            if (parseIntStrict(encoderPart, encoderIndex) &&
-                encoderIndex >= 0 && encoderIndex < numEncoders) {
-              encoders[encoderIndex].zeroColor = hexToColor(zeroHex);
-              encoders[encoderIndex].fullColor = hexToColor(fullHex);
-              updateEncoderLedDisplay(encoderIndex);
-            }
-          }
-        } else if (commandID == 'B') { // Background lighting: B:rgb or B:hexcolor
-          if (payload.length() > 0) {
-            if (payload.equalsIgnoreCase("rgb")) {
-              backgroundMode = BG_RGB;
-            } else if (payload.equalsIgnoreCase("off")) {
-              backgroundMode = BG_OFF;
-            } else {
-              backgroundMode = BG_SOLID;
-              Color c = hexToColor(payload);
-              backgroundSolidColor = c;
-            }
-          }
-        } else if (commandID == 'O') { // Output device select: O:index(1-4)
-          int selectedOneBasedIndex = 0;
-          if (!parseIntStrict(payload, selectedOneBasedIndex)) {
-            continue;
-          }
-          int requestedIndex = selectedOneBasedIndex - 1;
-          if (requestedIndex >= 0 && requestedIndex < numButtons) {
-            applyOutputSelection(requestedIndex, false);
-          }
-        }
+  trace(TRACE_COMMAND, (uint8_t)commandID, 0, payload.length());
+
+  if (commandID == 'V') { // Volume update: V:encoderIndex:volume(0.0-1.0)
+    int secondColonPos = payload.indexOf(':');
+    if (secondColonPos > 0) {
+      String indexPart = payload.substring(0, secondColonPos);
+      String volumePart = payload.substring(secondColonPos + 1);
+      indexPart.trim();
+      volumePart.trim();
+      int encoderIndex = -1;
+      float volume = 0.0f;
+      if (parseIntStrict(indexPart, encoderIndex) &&
+          parseFloatStrict(volumePart, volume) &&
+          encoderIndex >= 0 && encoderIndex < numEncoders) {
+        float clampedVolume = constrain(volume, 0.0f, 1.0f);
+        long clampedPosition = (long)round(clampedVolume * MAX_ENCODER_VALUE);
+        clampedPosition = constrain(clampedPosition, 0L, (long)MAX_ENCODER_VALUE);
+
+        // The knob moves in ENCODER_VOLUME_PER_COUNT steps; keep the position the count lands on, or the next
+        // scan would see it move there and report a turn nobody made
+        long count = volumeToEncoderCount(clampedPosition);
+        encoders[encoderIndex].setRawCount(count);
+        encoders[encoderIndex].lastDetentPosition =
+          (long)round(constrain(encoderCountToVolume(count), 0.0, (double)MAX_ENCODER_VALUE));
+        updateEncoderLedDisplay(encoderIndex);
+        encoderReportPending = true;
       }
-      serialBuffer = "";
-    } else {
-      if (c != '\r') {
-        serialBuffer += c;
+    }
+  } else if (commandID == 'C') { // Color update: C:encoderIndex:zeroHex:fullHex
+    int secondColonPos = payload.indexOf(':');
+    int thirdColonPos = payload.lastIndexOf(':');
+    if (secondColonPos > 0 && thirdColonPos > secondColonPos) {
+      String encoderPart = payload.substring(0, secondColonPos);
+      encoderPart.trim();
+      int encoderIndex = -1;
+      String zeroHex = payload.substring(secondColonPos + 1, thirdColonPos);
+      String fullHex = payload.substring(thirdColonPos + 1);
+      zeroHex.trim();
+      fullHex.trim();
+      if (parseIntStrict(encoderPart, encoderIndex) &&
+          encoderIndex >= 0 && encoderIndex < numEncoders) {
+        encoders[encoderIndex].zeroColor = hexToColor(zeroHex);
+        encoders[encoderIndex].fullColor = hexToColor(fullHex);
+        updateEncoderLedDisplay(encoderIndex);
       }
     }
+  } else if (commandID == 'B') { // Background lighting: B:rgb or B:hexcolor
+    if (payload.length() > 0) {
+      if (payload.equalsIgnoreCase("rgb")) {
+        backgroundMode = BG_RGB;
+      } else if (payload.equalsIgnoreCase("off")) {
+        backgroundMode = BG_OFF;
+      } else {
+        backgroundMode = BG_SOLID;
+        Color c = hexToColor(payload);
+        backgroundSolidColor = c;
+      }
+    }
+  } else if (commandID == 'S') { // State dump request: S: -> S:maxPosition:positions:mutedMask:outputs:backgroundHash:colorHash
+    sendStateDump();
+  } else if (commandID == 'T') { // Stage timing request: T: -> boot marker, then one T:name:runs:avgMicros:maxMicros:misses line per stage
+    sendStageTimings();
+  } else if (commandID == 'A') { // Animation definition: A:slot:leds:trigger:loop|once, or A:slot:clear
+    defineAnimation(payload);
+  } else if (commandID == 'K') { // Animation keyframe: K:slot:atMillis:hexColor, in ascending time order
+    addAnimationKeyframe(payload);
+  } else if (commandID == 'D') { // Trace dump request: D: or D:count -> D:firstEvent:hexEvents lines, then D:end:sent:overwritten
+    startTraceDump(payload);
+  } else if (commandID == 'P') { // Link health ping: P:seq:hostTimestamp -> Q:seq:hostTimestamp:millis:heldMicros
+    // Answered from the loop, so it can't land in the middle of another line. heldMicros is how long the ping
+    // waited since the RX callback queued it, which the host takes out of the round-trip time
+    Serial.print("Q:");
+    Serial.print(payload);
+    Serial.print(':');
+    Serial.print(millis());
+    Serial.print(':');
+    Serial.println((uint32_t)(micros() - receivedMicros));
+  } else if (commandID == 'O') { // Output device select: O:index(1-4)
+    int selectedOneBasedIndex = 0;
+    if (!parseIntStrict(payload, selectedOneBasedIndex)) {
+      return;
+    }
+    int requestedIndex = selectedOneBasedIndex - 1;
+    if (requestedIndex >= 0 && requestedIndex < numButtons) {
+      applyOutputSelection(requestedIndex, false);
+    }
   }
 }
 
+// --- Applied State Reporting ---
+// deej seeds its caches from the state dump, and only sends what differs from its own state.
+// Lighting is reported as FNV-1a (32 bit) hashes over the applied state's bytes, which must stay in sync with serial_state_sync.go
+const uint32_t FNV_OFFSET_BASIS = 2166136261u;
+const uint32_t FNV_PRIME = 16777619u;
+
+uint32_t fnv1a(uint32_t hash, uint8_t value) {
+  return (hash ^ value) * FNV_PRIME;
+}
+
+uint32_t fnv1aColor(uint32_t hash, const Color& c) {
+  hash = fnv1a(hash, c.r);
+  hash = fnv1a(hash, c.g);
+  return fnv1a(hash, c.b);
+}
+
+// Mode (0 off, 1 solid, 2 rgb), followed by the color for solid backgrounds
+uint32_t backgroundStateHash() {
+  uint32_t hash = fnv1a(FNV_OFFSET_BASIS, (uint8_t)backgroundMode);
+  if (backgroundMode == BG_SOLID) {
+    hash = fnv1aColor(hash, backgroundSolidColor);
+  }
+  return hash;
+}
+
+uint32_t fnv1aString(uint32_t hash, const String& value) {
+  for (unsigned int i = 0; i < value.length(); i++) {
+    hash = fnv1a(hash, (uint8_t)value.charAt(i));
+  }
+  return fnv1a(hash, '\n');
+}
+
+// Every slot's hash (0 when empty), little endian
+uint32_t animationStateHash() {
+  uint32_t hash = FNV_OFFSET_BASIS;
+  for (int i = 0; i < NUM_ANIMATIONS; i++) {
+    uint32_t slotHash = animations[i].defined ? animations[i].hash : 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+      hash = fnv1a(hash, (uint8_t)(slotHash >> shift));
+    }
+  }
+  return hash;
+}
+
+// Zero and full color of every encoder, in order
+uint32_t colorStateHash() {
+  uint32_t hash = FNV_OFFSET_BASIS;
+  for (int i = 0; i < numEncoders; i++) {
+    hash = fnv1aColor(hash, encoders[i].zeroColor);
+    hash = fnv1aColor(hash, encoders[i].fullColor);
+  }
+  return hash;
+}
+
+// Encoder positions, muted encoders (bitmask), selected output per button group (1-based, 0 for none),
+// lighting hashes and the animation hash
+void sendStateDump() {
+  uint32_t mutedMask = 0;
+
+  Serial.print("S:");
+  Serial.print(MAX_ENCODER_VALUE);
+  Serial.print(':');
+  for (int i = 0; i < numEncoders; i++) {
+    if (i > 0) Serial.print(',');
+    Serial.print(encoders[i].lastDetentPosition);
+    if (encoders[i].isMuted) mutedMask |= (1UL << i);
+  }
+  Serial.print(':');
+  Serial.print(mutedMask, HEX);
+  Serial.print(':');
+  for (int g = 0; g < NUM_BUTTON_GROUPS; g++) {
+    if (g > 0) Serial.print(',');
+    Serial.print(selectedOutputIndexByGroup[g] + 1);
+  }
+  Serial.print(':');
+  Serial.print(backgroundStateHash(), HEX);
+  Serial.print(':');
+  Serial.print(colorStateHash(), HEX);
+  Serial.print(':');
+  Serial.println(animationStateHash(), HEX);
+}
+
 // --- LED Control Functions ---
 void updateEncoderLedDisplay(int encoderIndex) {
   EncoderInfo& enc = encoders[encoderIndex];
@@ -429,9 +1046,60 @@ void updateEncoderLedDisplay(int encoderIndex) {
   }
 }
 
+LedPriority ledPriority(int ledIndex) {
+  return ledIndex + 1 >= BACKLIGHT_FIRST_LED ? LED_PRIORITY_AMBIENT : LED_PRIORITY_INTERACTIVE;
+}
+
 void setSingleLedColor(int ledNum, const Color& c) {
   if (ledNum < 1 || ledNum > TOTAL_LEDS) return;
 
+  int ledIndex = ledNum - 1;
+  ledTarget[ledIndex] = c;
+
+  const Color& shown = ledShown[ledIndex];
+  bool dirty = c.r != shown.r || c.g != shown.g || c.b != shown.b;
+  if (dirty != ledDirty[ledIndex]) {
+    ledDirty[ledIndex] = dirty;
+    dirtyLedCount[ledPriority(ledIndex)] += dirty ? 1 : -1;
+  }
+}
+
+bool ledsDirty() {
+  return dirtyLedCount[LED_PRIORITY_INTERACTIVE] > 0 || dirtyLedCount[LED_PRIORITY_AMBIENT] > 0;
+}
+
+void flushLed(int ledIndex) {
+  writeLedColor(ledIndex + 1, ledTarget[ledIndex]);
+  ledShown[ledIndex] = ledTarget[ledIndex];
+  ledDirty[ledIndex] = false;
+  dirtyLedCount[ledPriority(ledIndex)]--;
+}
+
+void flushLeds() {
+  unsigned long start = micros();
+
+  for (int i = 0; i < TOTAL_LEDS && dirtyLedCount[LED_PRIORITY_INTERACTIVE] > 0; i++) {
+    if (ledDirty[i] && ledPriority(i) == LED_PRIORITY_INTERACTIVE) {
+      flushLed(i);
+    }
+  }
+
+  // Round robin, so the same backlight LEDs don't always miss the budget
+  for (int n = 0; n < BACKLIGHT_LED_COUNT && dirtyLedCount[LED_PRIORITY_AMBIENT] > 0; n++) {
+    if (micros() - start >= LED_FLUSH_BUDGET_MICROS) {
+      break;
+    }
+    int i = BACKLIGHT_FIRST_LED - 1 + ambientFlushCursor;
+    ambientFlushCursor = (ambientFlushCursor + 1) % BACKLIGHT_LED_COUNT;
+    if (ledDirty[i]) {
+      flushLed(i);
+    }
+  }
+}
+
+void writeLedColor(int ledNum, const Color& c) {
+  if (ledNum < 1 || ledNum > TOTAL_LEDS) return;
+
   int bankIndex = (ledNum - 1) / LEDS_PER_BANK;
   digitalWrite(MUX_SELECT_PIN, bankIndex == 0 ? LOW : HIGH);
 
@@ -441,13 +1109,20 @@ void setSingleLedColor(int ledNum, const Color& c) {
   int ledNumOnChip = ledNumInBank % LEDS_PER_CHIP;
   int baseOutput = ledNumOnChip * 3;
 
+  unsigned long start = micros();
   Wire.beginTransmission(chipAddress);
   Wire.write(OUT0_COLOR_ADDR + baseOutput);
   Wire.write(c.r); Wire.write(c.g); Wire.write(c.b);
-  Wire.endTransmission();
+  uint8_t status = Wire.endTransmission();
+  trace(TRACE_I2C, chipAddress, OUT0_COLOR_ADDR + baseOutput, ((micros() - start) << 8) | status);
 }
 
 void updateBackgroundLighting() {
+  // The previous frame hasn't been fully shown yet, skip this one rather than tearing
+  if (dirtyLedCount[LED_PRIORITY_AMBIENT] > 0) {
+    return;
+  }
+
   switch (backgroundMode) {
     case BG_RGB:
       for (int i = 0; i < BACKLIGHT_LED_COUNT; i++) {
@@ -474,6 +1149,363 @@ void updateBackgroundLighting() {
   }
 }
 
+// --- Keyframe Animations ---
+void renderLighting() {
+  updateBackgroundLighting();
+  renderAnimations();
+}
+
+// Splits off the next ':' separated field of a payload
+String nextField(const String& payload, int& position) {
+  int end = payload.indexOf(':', position);
+  String field = end < 0 ? payload.substring(position) : payload.substring(position, end);
+  position = end < 0 ? payload.length() : end + 1;
+  field.trim();
+  return field;
+}
+
+// "backlight", "buttons", "ringN" (1-based encoder) or "first-last" (1-based LED numbers)
+bool parseLedRange(const String& target, int& firstLed, int& lastLed) {
+  if (target.equalsIgnoreCase("backlight")) {
+    firstLed = BACKLIGHT_FIRST_LED;
+    lastLed = BACKLIGHT_LAST_LED;
+  } else if (target.equalsIgnoreCase("buttons")) {
+    firstLed = buttons[0].ledNum;
+    lastLed = buttons[numButtons - 1].ledNum;
+  } else if (target.startsWith("ring")) {
+    int ring = 0;
+    if (!parseIntStrict(target.substring(4), ring) || ring < 1 || ring > numEncoders) {
+      return false;
+    }
+    firstLed = encoders[ring - 1].startLed;
+    lastLed = firstLed + ENCODER_LED_COUNT - 1;
+  } else {
+    int dash = target.indexOf('-');
+    if (dash <= 0 || !parseIntStrict(target.substring(0, dash), firstLed) || !parseIntStrict(target.substring(dash + 1), lastLed)) {
+      return false;
+    }
+  }
+  return firstLed >= 1 && lastLed <= TOTAL_LEDS && firstLed <= lastLed;
+}
+
+// "always", "button" or "buttonN", "mute" or "muteN" (N is 1-based, without it any button or encoder triggers)
+bool parseAnimationTrigger(const String& spec, AnimationTrigger& trigger, uint8_t& index) {
+  String rest;
+  int limit;
+  if (spec.equalsIgnoreCase("always")) {
+    trigger = TRIGGER_ALWAYS;
+    index = TRIGGER_ANY_INDEX;
+    return true;
+  } else if (spec.startsWith("button")) {
+    trigger = TRIGGER_BUTTON;
+    rest = spec.substring(6);
+    limit = numButtons;
+  } else if (spec.startsWith("mute")) {
+    trigger = TRIGGER_MUTE;
+    rest = spec.substring(4);
+    limit = numEncoders;
+  } else {
+    return false;
+  }
+
+  if (rest.length() == 0) {
+    index = TRIGGER_ANY_INDEX;
+    return true;
+  }
+  int oneBased = 0;
+  if (!parseIntStrict(rest, oneBased) || oneBased < 1 || oneBased > limit) {
+    return false;
+  }
+  index = oneBased - 1;
+  return true;
+}
+
+// Puts back what the LEDs under a stopped animation normally show. The backlight is redrawn every frame anyway
+void restoreLedRange(int firstLed, int lastLed) {
+  for (int i = 0; i < numEncoders; i++) {
+    int ringFirst = encoders[i].startLed;
+    int ringLast = ringFirst + ENCODER_LED_COUNT - 1;
+    if (ringFirst <= lastLed && ringLast >= firstLed) {
+      updateEncoderLedDisplay(i);
+    }
+  }
+  for (int i = 0; i < numButtons; i++) {
+    if (buttons[i].ledNum >= firstLed && buttons[i].ledNum <= lastLed) {
+      bool isSelected = selectedOutputIndexByGroup[buttons[i].group] == i;
+      setSingleLedColor(buttons[i].ledNum, isSelected ? BUTTON_ACTIVE_COLOR : BUTTON_INACTIVE_COLOR);
+    }
+  }
+}
+
+void stopAnimation(Animation& animation) {
+  if (animation.playing) {
+    animation.playing = false;
+    restoreLedRange(animation.firstLed, animation.lastLed);
+  }
+}
+
+void defineAnimation(const String& payload) {
+  int position = 0;
+  int slot = -1;
+  if (!parseIntStrict(nextField(payload, position), slot) || slot < 0 || slot >= NUM_ANIMATIONS) {
+    return;
+  }
+
+  Animation& animation = animations[slot];
+  stopAnimation(animation);
+  animation.defined = false;
+  animation.keyframeCount = 0;
+
+  String target = nextField(payload, position);
+  if (target.equalsIgnoreCase("clear")) {
+    assetRelease(slot);
+    return;
+  }
+
+  String trigger = nextField(payload, position);
+  String repeat = nextField(payload, position);
+  if (!parseLedRange(target, animation.firstLed, animation.lastLed) ||
+      !parseAnimationTrigger(trigger, animation.trigger, animation.triggerIndex) ||
+      !(repeat.equalsIgnoreCase("loop") || repeat.equalsIgnoreCase("once"))) {
+    return;
+  }
+
+  animation.loop = repeat.equalsIgnoreCase("loop");
+  animation.hash = fnv1aString(FNV_OFFSET_BASIS, payload);
+  animation.defined = true;
+  animation.playing = animation.trigger == TRIGGER_ALWAYS;
+  animation.startMillis = millis();
+}
+
+void addAnimationKeyframe(const String& payload) {
+  int position = 0;
+  int slot = -1;
+  int atMillis = -1;
+  if (!parseIntStrict(nextField(payload, position), slot) || slot < 0 || slot >= NUM_ANIMATIONS) {
+    return;
+  }
+
+  Animation& animation = animations[slot];
+  if (!animation.defined || animation.keyframeCount >= MAX_ANIMATION_KEYFRAMES) {
+    return;
+  }
+  if (!parseIntStrict(nextField(payload, position), atMillis) || atMillis < 0 || atMillis > 0xFFFF) {
+    return;
+  }
+
+  size_t size = 0;
+  const Keyframe* existing = (const Keyframe*)assetData(slot, size);
+  if (animation.keyframeCount > 0 && atMillis < existing[animation.keyframeCount - 1].atMillis) {
+    return;
+  }
+
+  Keyframe* keyframes = (Keyframe*)assetReserve(slot, (animation.keyframeCount + 1) * sizeof(Keyframe));
+  if (keyframes == nullptr) {
+    return;
+  }
+
+  keyframes[animation.keyframeCount].atMillis = atMillis;
+  keyframes[animation.keyframeCount].color = hexToColor(nextField(payload, position));
+  animation.keyframeCount++;
+  animation.hash = fnv1aString(animation.hash, payload);
+}
+
+void triggerAnimations(AnimationTrigger trigger, uint8_t index) {
+  for (int i = 0; i < NUM_ANIMATIONS; i++) {
+    Animation& animation = animations[i];
+    if (!animation.defined || animation.trigger != trigger) {
+      continue;
+    }
+    if (animation.triggerIndex != TRIGGER_ANY_INDEX && animation.triggerIndex != index) {
+      continue;
+    }
+
+    if (animation.loop && animation.playing) {
+      stopAnimation(animation);
+    } else {
+      animation.playing = true;
+      animation.startMillis = millis();
+    }
+  }
+}
+
+Color animationColorAt(const Keyframe* keyframes, int count, unsigned long atMillis) {
+  if (atMillis <= keyframes[0].atMillis) {
+    return keyframes[0].color;
+  }
+  for (int k = 1; k < count; k++) {
+    if (atMillis < keyframes[k].atMillis) {
+      const Keyframe& from = keyframes[k - 1];
+      float t = (float)(atMillis - from.atMillis) / (keyframes[k].atMillis - from.atMillis);
+      return lerp(from.color, keyframes[k].color, t);
+    }
+  }
+  return keyframes[count - 1].color;
+}
+
+void renderAnimations() {
+  unsigned long now = millis();
+
+  for (int i = 0; i < NUM_ANIMATIONS; i++) {
+    Animation& animation = animations[i];
+    if (!animation.defined || !animation.playing || animation.keyframeCount == 0) {
+      continue;
+    }
+
+    size_t size = 0;
+    const Keyframe* keyframes = (const Keyframe*)assetData(i, size);
+    unsigned long duration = keyframes[animation.keyframeCount - 1].atMillis;
+    unsigned long elapsed = now - animation.startMillis;
+
+    if (elapsed > duration) {
+      if (!animation.loop) {
+        stopAnimation(animation);
+        continue;
+      }
+      elapsed = duration > 0 ? elapsed % duration : 0;
+    }
+
+    Color color = animationColorAt(keyframes, animation.keyframeCount, elapsed);
+    for (int led = animation.firstLed; led <= animation.lastLed; led++) {
+      setSingleLedColor(led, color);
+    }
+  }
+}
+
+// --- PSRAM Storage ---
+void* psramAlloc(size_t bytes) {
+  if (!psramFound()) {
+    return nullptr;
+  }
+  return ps_malloc(bytes);
+}
+
+void psramFree(void* ptr) {
+  free(ptr);
+}
+
+void beginTrace() {
+  traceEvents = (TraceEvent*)psramAlloc(TRACE_CAPACITY * sizeof(TraceEvent));
+}
+
+void trace(TraceType type, uint8_t a, uint16_t b, uint32_t c) {
+  if (traceEvents == nullptr) {
+    return;
+  }
+
+  TraceEvent& event = traceEvents[traceHead % TRACE_CAPACITY];
+  event.micros = micros();
+  event.type = type;
+  event.a = a;
+  event.b = b;
+  event.c = c;
+  traceHead++;
+}
+
+// Streams the most recent events (all of them by default) from the trace stage, so other stages keep running.
+// Events are sent as the hex of their 12 bytes (little endian micros, type, a, b, c), 8 per line
+void startTraceDump(const String& payload) {
+  uint32_t available = traceHead < TRACE_CAPACITY ? traceHead : TRACE_CAPACITY;
+  int requested = 0;
+  if (payload.length() > 0 && parseIntStrict(payload, requested) && requested >= 0 && (uint32_t)requested < available) {
+    available = requested;
+  }
+
+  traceDumpEnd = traceHead;
+  traceDumpCursor = traceHead - available;
+  traceDumpSent = 0;
+  traceDumpOverwritten = 0;
+  traceDumpActive = true;
+}
+
+bool traceDumpPending() {
+  return traceDumpActive;
+}
+
+void sendTraceDump() {
+  static const char HEX_DIGITS[] = "0123456789ABCDEF";
+  const size_t lineLength = 2 + 11 + 1 + TRACE_DUMP_EVENTS_PER_LINE * sizeof(TraceEvent) * 2 + 2;
+  char line[lineLength + 1];
+
+  for (int n = 0; n < TRACE_DUMP_LINES_PER_RUN && traceDumpCursor != traceDumpEnd; n++) {
+    if ((size_t)Serial.availableForWrite() < lineLength) {
+      return; // Let the host catch up, the next run continues from here
+    }
+
+    // Events that were recorded over while we were sending are lost
+    if (traceHead - traceDumpCursor > TRACE_CAPACITY) {
+      uint32_t oldest = traceHead - TRACE_CAPACITY;
+      traceDumpOverwritten += oldest - traceDumpCursor;
+      traceDumpCursor = oldest;
+    }
+
+    int length = snprintf(line, sizeof(line), "D:%lu:", (unsigned long)traceDumpCursor);
+    for (int e = 0; e < TRACE_DUMP_EVENTS_PER_LINE && traceDumpCursor != traceDumpEnd; e++) {
+      const uint8_t* bytes = (const uint8_t*)&traceEvents[traceDumpCursor % TRACE_CAPACITY];
+      for (size_t i = 0; i < sizeof(TraceEvent); i++) {
+        line[length++] = HEX_DIGITS[bytes[i] >> 4];
+        line[length++] = HEX_DIGITS[bytes[i] & 0x0F];
+      }
+      traceDumpCursor++;
+      traceDumpSent++;
+    }
+    line[length] = '\0';
+    Serial.println(line);
+  }
+
+  if (traceDumpCursor == traceDumpEnd) {
+    Serial.print("D:end:");
+    Serial.print(traceDumpSent);
+    Serial.print(':');
+    Serial.println(traceDumpOverwritten);
+    traceDumpActive = false;
+  }
+}
+
+// Resizes the slot's PSRAM buffer, keeping its contents. Growing at least doubles the allocation
+uint8_t* assetReserve(int slot, size_t size) {
+  if (slot < 0 || slot >= NUM_ASSET_SLOTS) {
+    return nullptr;
+  }
+
+  AssetSlot& asset = assetSlots[slot];
+  if (asset.capacity < size) {
+    size_t capacity = size > asset.capacity * 2 ? size : asset.capacity * 2;
+    uint8_t* data = (uint8_t*)psramAlloc(capacity);
+    if (data == nullptr) {
+      return nullptr;
+    }
+    if (asset.data != nullptr) {
+      memcpy(data, asset.data, asset.size < size ? asset.size : size);
+    }
+    psramFree(asset.data);
+    asset.data = data;
+    asset.capacity = capacity;
+  }
+
+  asset.size = size;
+  return asset.data;
+}
+
+const uint8_t* assetData(int slot, size_t& size) {
+  if (slot < 0 || slot >= NUM_ASSET_SLOTS || assetSlots[slot].data == nullptr) {
+    size = 0;
+    return nullptr;
+  }
+
+  size = assetSlots[slot].size;
+  return assetSlots[slot].data;
+}
+
+void assetRelease(int slot) {
+  if (slot < 0 || slot >= NUM_ASSET_SLOTS) {
+    return;
+  }
+
+  psramFree(assetSlots[slot].data);
+  assetSlots[slot] = {nullptr, 0, 0};
+}
+
 // --- Utility Functions ---
 Color hexToColor(String hex) {
   hex.trim();
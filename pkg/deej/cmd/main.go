@@ -3,6 +3,7 @@ package main
 import (
 	"flag"
 	"fmt"
+	"os"
 
 	"github.com/omriharel/deej/pkg/deej"
 )
@@ -13,11 +14,19 @@ var (
 	buildType  string
 
 	verbose bool
+
+	replayPath  string
+	replaySpeed float64
+
+	firmwareLoop string
 )
 
 func init() {
 	flag.BoolVar(&verbose, "verbose", false, "show verbose logs (useful for debugging serial)")
 	flag.BoolVar(&verbose, "v", false, "shorthand for --verbose")
+	flag.StringVar(&replayPath, "replay", "", "replay a serial capture file against fake sessions, then exit")
+	flag.Float64Var(&replaySpeed, "replay-speed", 1, "replay speed multiplier (0 replays as fast as possible)")
+	flag.StringVar(&firmwareLoop, "firmware-loop", "", "run the firmware built for Linux (see arduino/host) against deej over a pty, then exit")
 	flag.Parse()
 }
 
@@ -42,6 +51,35 @@ func main() {
 		named.Debug("Verbose flag provided, all log messages will be shown")
 	}
 
+	// replaying a capture doesn't need a full deej instance
+	if replayPath != "" {
+		report, err := deej.ReplaySerialCapture(logger, replayPath, replaySpeed)
+		if err != nil {
+			named.Fatalw("Failed to replay serial capture", "error", err)
+		}
+
+		fmt.Println(report)
+		return
+	}
+
+	if firmwareLoop != "" {
+		report, err := deej.RunFirmwareLoop(logger, firmwareLoop)
+		if err != nil {
+			named.Fatalw("Failed to run firmware loop", "error", err)
+		}
+
+		fmt.Println(report)
+		for _, failure := range report.Failures {
+			fmt.Println("FAIL:", failure)
+		}
+
+		if len(report.Failures) > 0 {
+			logger.Sync()
+			os.Exit(1)
+		}
+		return
+	}
+
 	// create the deej instance
 	d, err := deej.NewDeej(logger, verbose)
 	if err != nil {
@@ -3,24 +3,110 @@ package deej
 import (
 	"os/exec"
 	"strings"
+	"time"
+
+	"go.uber.org/zap"
 
 	"github.com/omriharel/deej/pkg/deej/util"
 )
 
-// RunConfiguredCommand executes the command configured for the given index, if any.
-func (d *Deej) RunConfiguredCommand(index int) {
+// setupCommandExecutor warms up the persistent shell worker when it's enabled,
+// and starts or stops it as the config changes
+func (d *Deej) setupCommandExecutor() {
+	if d.config.Snapshot().CommandExecutor == commandExecutorPersistent {
+		go d.shellWorkers.warmUp()
+	}
+
+	configReloadedChannel := d.config.SubscribeToChanges()
+
+	go func() {
+		for {
+			select {
+			case <-configReloadedChannel:
+				if d.config.Snapshot().CommandExecutor == commandExecutorPersistent {
+					d.shellWorkers.warmUp()
+				} else {
+					d.shellWorkers.stop()
+				}
+			}
+		}
+	}()
+}
+
+// RunConfiguredCommand executes the command configured for the given output index, if any. commands for the same
+// button group run one at a time, and only the latest selection made while one runs is executed after it (see
+// outputActionQueues). a negative group means the controller didn't report one
+func (d *Deej) RunConfiguredCommand(index int, group int) {
 	logger := d.logger.Named("commands")
 
-	spec, ok := d.config.Commands[index]
-	if !ok || len(spec.Args) == 0 {
+	spec, ok := d.config.Snapshot().Commands[index]
+	if !ok || (len(spec.Args) == 0 && spec.Action == "") {
 		if d.Verbose() {
 			logger.Debugw("No command configured for index", "index", index)
 		}
 		return
 	}
 
+	d.outputActions.submit(group, index, spec)
+}
+
+// RunGestureCommand executes the command configured for a controller gesture, if any
+func (d *Deej) RunGestureCommand(gesture string) {
+	logger := d.logger.Named("commands")
+
+	spec, ok := d.config.Snapshot().Gestures[gesture]
+	if !ok || (len(spec.Args) == 0 && spec.Action == "") {
+		if d.Verbose() {
+			logger.Debugw("No command configured for gesture", "gesture", gesture)
+		}
+		return
+	}
+
+	d.runCommandSpec(logger.With("gesture", gesture), spec)
+}
+
+// runCommandSpec runs a configured command or action in the background. the logger carries what triggered it
+func (d *Deej) runCommandSpec(logger *zap.SugaredLogger, spec CommandSpec) {
+	go d.executeCommandSpec(logger, spec)
+}
+
+// executeCommandSpec runs a configured command or action, and returns once it's finished
+func (d *Deej) executeCommandSpec(logger *zap.SugaredLogger, spec CommandSpec) {
+	if spec.Action != "" {
+		start := time.Now()
+		output := spec.Action == commandActionDefaultSink
+
+		if err := d.sessions.switchDefaultDevice(spec.Device, output, spec.MoveStreams); err != nil {
+			logger.Warnw("Failed to run configured action", "action", spec.Action, "device", spec.Device, "error", err)
+			return
+		}
+
+		if d.Verbose() {
+			logger.Debugw("Configured action finished successfully", "action", spec.Action, "took", time.Since(start))
+		}
+
+		return
+	}
+
 	args := append([]string(nil), spec.Args...)
 
+	if spec.Shell && d.config.Snapshot().CommandExecutor == commandExecutorPersistent {
+		commandLine := strings.Join(args, " ")
+		start := time.Now()
+
+		output, err := d.shellWorkers.run(commandLine)
+		if err != nil {
+			logger.Warnw("Configured command failed in shell worker", "command", commandLine, "output", output, "error", err)
+			return
+		}
+
+		if d.Verbose() {
+			logger.Debugw("Configured command finished successfully", "command", commandLine, "took", time.Since(start))
+		}
+
+		return
+	}
+
 	if spec.Shell {
 		commandLine := strings.Join(args, " ")
 		if util.Windows() {
@@ -32,33 +118,32 @@ func (d *Deej) RunConfiguredCommand(index int) {
 
 	if len(args) == 0 {
 		if d.Verbose() {
-			logger.Debugw("Command payload empty after processing", "index", index)
+			logger.Debugw("Command payload empty after processing")
 		}
 		return
 	}
 
-	command := args[0]
-	commandArgs := append([]string(nil), args[1:]...)
+	cmdName := args[0]
+	cmdArgs := append([]string(nil), args[1:]...)
 
-	go func(cmdName string, cmdArgs []string) {
-		cmd := exec.Command(cmdName, cmdArgs...)
+	start := time.Now()
+	cmd := exec.Command(cmdName, cmdArgs...)
 
-		if err := cmd.Start(); err != nil {
-			logger.Warnw("Failed to execute configured command", "index", index, "command", cmdName, "args", cmdArgs, "error", err)
-			return
-		}
+	if err := cmd.Start(); err != nil {
+		logger.Warnw("Failed to execute configured command", "command", cmdName, "args", cmdArgs, "error", err)
+		return
+	}
 
-		if d.Verbose() {
-			logger.Debugw("Started configured command", "index", index, "command", cmdName, "args", cmdArgs)
-		}
+	if d.Verbose() {
+		logger.Debugw("Started configured command", "command", cmdName, "args", cmdArgs)
+	}
 
-		if err := cmd.Wait(); err != nil {
-			logger.Warnw("Configured command exited with error", "index", index, "command", cmdName, "args", cmdArgs, "error", err)
-			return
-		}
+	if err := cmd.Wait(); err != nil {
+		logger.Warnw("Configured command exited with error", "command", cmdName, "args", cmdArgs, "error", err)
+		return
+	}
 
-		if d.Verbose() {
-			logger.Debugw("Configured command finished successfully", "index", index, "command", cmdName)
-		}
-	}(command, commandArgs)
+	if d.Verbose() {
+		logger.Debugw("Configured command finished successfully", "command", cmdName, "took", time.Since(start))
+	}
 }
@@ -6,9 +6,12 @@ import (
 	"fmt"
 	"io/ioutil"
 	"path"
+	"regexp"
+	"sort"
 	"strconv"
 	"strings"
 	"sync"
+	"sync/atomic"
 	"time"
 
 	"github.com/fsnotify/fsnotify"
@@ -25,12 +28,43 @@ type SliderColorConfig struct {
 	Full string `mapstructure:"full"`
 }
 
+// ControllerConfig describes one serial controller. its sliders map to deej's slider indices starting at
+// SliderOffset, and it owns Sliders of them (or, if that's unset, every index up to the next controller's offset)
+type ControllerConfig struct {
+	COMPort      string `mapstructure:"com_port"`
+	BaudRate     int    `mapstructure:"baud_rate"`
+	SliderOffset int    `mapstructure:"slider_offset"`
+	Sliders      int    `mapstructure:"sliders"`
+}
+
+// AnimationConfig describes a keyframed lighting animation that controllers play on their own.
+// LEDs and Trigger use the firmware's names (see parseAnimations)
+type AnimationConfig struct {
+	LEDs      string              `mapstructure:"leds"`
+	Trigger   string              `mapstructure:"trigger"`
+	Loop      bool                `mapstructure:"loop"`
+	Keyframes []AnimationKeyframe `mapstructure:"keyframes"`
+}
+
+// AnimationKeyframe is the color an animation shows At milliseconds from its start
+type AnimationKeyframe struct {
+	At    int    `mapstructure:"at"`
+	Color string `mapstructure:"color"`
+}
+
 type CommandSpec struct {
 	Args  []string
 	Shell bool
+
+	// built-in actions run natively instead of through a process (see commandAction* constants)
+	Action      string
+	Device      string
+	MoveStreams bool
 }
 
-type CanonicalConfig struct {
+// ConfigSnapshot is one loaded version of deej's configuration. a snapshot is never modified once it's
+// published, so readers load the current one (lock-free) and use it for everything they're handling
+type ConfigSnapshot struct {
 	SliderMapping *sliderMap
 	SliderCount   int
 
@@ -39,6 +73,10 @@ type CanonicalConfig struct {
 		BaudRate int
 	}
 
+	// every controller deej connects to, sorted by slider offset. without a "controllers" key,
+	// this holds a single controller built from ConnectionInfo
+	Controllers []ControllerConfig
+
 	InvertSliders bool
 
 	NoiseReductionLevel string
@@ -47,7 +85,16 @@ type CanonicalConfig struct {
 	SyncVolumes        bool
 	ColorMapping       map[int]SliderColorConfig
 	BackgroundLighting string
+	Animations         []AnimationConfig
 	Commands           map[int]CommandSpec
+	Gestures           map[string]CommandSpec
+	CommandExecutor    string
+}
+
+type CanonicalConfig struct {
+
+	// the current *ConfigSnapshot. a reload builds a new one and swaps it in as a whole
+	snapshot atomic.Value
 
 	logger             *zap.SugaredLogger
 	notifier           Notifier
@@ -84,10 +131,32 @@ const (
 	configKeyColorMapping        = "color_mapping"
 	configKeyBackgroundLighting  = "background_lighting"
 	configKeyCommands            = "commands"
+	configKeyCommandExecutor     = "command_executor"
+	configKeyControllers         = "controllers"
+	configKeyAnimations          = "animations"
+	configKeyGestures            = "gestures"
+
+	// shell commands run in a new process each time (spawn) or in a warm, long-lived shell (persistent)
+	commandExecutorSpawn      = "spawn"
+	commandExecutorPersistent = "persistent"
+
+	// built-in command actions that switch the system's default output or input device
+	commandActionDefaultSink   = "default_sink"
+	commandActionDefaultSource = "default_source"
 
 	defaultCOMPort  = "COM4"
 	defaultBaudRate = 9600
 	defaultSliders  = 5
+
+	// limits of the firmware's animation storage
+	maxAnimations         = 4
+	maxAnimationKeyframes = 64
+	maxAnimationMillis    = 65535
+)
+
+var (
+	animationLEDsPattern    = regexp.MustCompile(`^(backlight|buttons|ring[1-9][0-9]*|[1-9][0-9]*-[1-9][0-9]*)$`)
+	animationTriggerPattern = regexp.MustCompile(`^(always|button([1-9][0-9]*)?|mute([1-9][0-9]*)?)$`)
 )
 
 // has to be defined as a non-constant because we're using path.Join
@@ -111,6 +180,8 @@ func NewConfig(logger *zap.SugaredLogger, notifier Notifier) (*CanonicalConfig,
 		stopWatcherChannel: make(chan bool),
 	}
 
+	cc.publish(&ConfigSnapshot{SliderMapping: newSliderMap()})
+
 	// distinguish between the user-provided config (config.yaml) and the internal config (logs/preferences.yaml)
 	userConfig := viper.New()
 	userConfig.SetConfigName(userConfigName)
@@ -127,6 +198,10 @@ func NewConfig(logger *zap.SugaredLogger, notifier Notifier) (*CanonicalConfig,
 	userConfig.SetDefault(configKeyColorMapping, map[string]map[string]string{})
 	userConfig.SetDefault(configKeyBackgroundLighting, "")
 	userConfig.SetDefault(configKeyCommands, map[string]interface{}{})
+	userConfig.SetDefault(configKeyCommandExecutor, commandExecutorSpawn)
+	userConfig.SetDefault(configKeyControllers, []interface{}{})
+	userConfig.SetDefault(configKeyAnimations, []interface{}{})
+	userConfig.SetDefault(configKeyGestures, map[string]interface{}{})
 
 	internalConfig := viper.New()
 	internalConfig.SetConfigName(internalConfigName)
@@ -180,17 +255,30 @@ func (cc *CanonicalConfig) Load() error {
 		return fmt.Errorf("populate config fields: %w", err)
 	}
 
+	snapshot := cc.Snapshot()
+
 	cc.logger.Info("Loaded config successfully")
 	cc.logger.Infow("Config values",
-		"sliderMapping", cc.SliderMapping,
-		"connectionInfo", cc.ConnectionInfo,
-		"invertSliders", cc.InvertSliders,
-		"sliderCount", cc.SliderCount)
+		"sliderMapping", snapshot.SliderMapping,
+		"connectionInfo", snapshot.ConnectionInfo,
+		"controllers", snapshot.Controllers,
+		"invertSliders", snapshot.InvertSliders,
+		"sliderCount", snapshot.SliderCount)
 	cc.captureConfigFingerprint()
 
 	return nil
 }
 
+// Snapshot returns the current configuration, which never changes - a reload publishes a new snapshot instead
+func (cc *CanonicalConfig) Snapshot() *ConfigSnapshot {
+	return cc.snapshot.Load().(*ConfigSnapshot)
+}
+
+// publish makes a snapshot the current configuration. it mustn't be modified afterwards
+func (cc *CanonicalConfig) publish(snapshot *ConfigSnapshot) {
+	cc.snapshot.Store(snapshot)
+}
+
 // SubscribeToChanges allows external components to receive updates when the config is reloaded
 func (cc *CanonicalConfig) SubscribeToChanges() chan bool {
 	c := make(chan bool)
@@ -261,52 +349,68 @@ func (cc *CanonicalConfig) StopWatchingConfigFile() {
 }
 
 func (cc *CanonicalConfig) populateFromVipers() error {
+	snapshot := &ConfigSnapshot{}
 
 	// merge the slider mappings from the user and internal configs
-	cc.SliderMapping = sliderMapFromConfigs(
+	snapshot.SliderMapping = sliderMapFromConfigs(
 		cc.userConfig.GetStringMapStringSlice(configKeySliderMapping),
 		cc.internalConfig.GetStringMapStringSlice(configKeySliderMapping),
 	)
 
 	// get the rest of the config fields - viper saves us a lot of effort here
-	cc.ConnectionInfo.COMPort = cc.userConfig.GetString(configKeyCOMPort)
+	snapshot.ConnectionInfo.COMPort = cc.userConfig.GetString(configKeyCOMPort)
 
-	cc.ConnectionInfo.BaudRate = cc.userConfig.GetInt(configKeyBaudRate)
-	if cc.ConnectionInfo.BaudRate <= 0 {
+	snapshot.ConnectionInfo.BaudRate = cc.userConfig.GetInt(configKeyBaudRate)
+	if snapshot.ConnectionInfo.BaudRate <= 0 {
 		cc.logger.Warnw("Invalid baud rate specified, using default value",
 			"key", configKeyBaudRate,
-			"invalidValue", cc.ConnectionInfo.BaudRate,
+			"invalidValue", snapshot.ConnectionInfo.BaudRate,
 			"defaultValue", defaultBaudRate)
 
-		cc.ConnectionInfo.BaudRate = defaultBaudRate
+		snapshot.ConnectionInfo.BaudRate = defaultBaudRate
 	}
 
-	cc.InvertSliders = cc.userConfig.GetBool(configKeyInvertSliders)
-	cc.NoiseReductionLevel = cc.userConfig.GetString(configKeyNoiseReductionLevel)
-	cc.SendOnStartup = cc.userConfig.GetBool(configKeySendOnStartup)
-	cc.SyncVolumes = cc.userConfig.GetBool(configKeySyncVolumes)
-	cc.ColorMapping = cc.parseColorMapping()
-	cc.SliderCount = cc.userConfig.GetInt(configKeySliderCount)
-	if cc.SliderCount <= 0 {
-		cc.SliderCount = cc.inferSliderCount()
+	snapshot.Controllers = cc.parseControllers(snapshot.ConnectionInfo.COMPort, snapshot.ConnectionInfo.BaudRate)
+
+	snapshot.InvertSliders = cc.userConfig.GetBool(configKeyInvertSliders)
+	snapshot.NoiseReductionLevel = cc.userConfig.GetString(configKeyNoiseReductionLevel)
+	snapshot.SendOnStartup = cc.userConfig.GetBool(configKeySendOnStartup)
+	snapshot.SyncVolumes = cc.userConfig.GetBool(configKeySyncVolumes)
+	snapshot.ColorMapping = cc.parseColorMapping()
+	snapshot.SliderCount = cc.userConfig.GetInt(configKeySliderCount)
+	if snapshot.SliderCount <= 0 {
+		snapshot.SliderCount = inferSliderCount(snapshot)
+	}
+	snapshot.BackgroundLighting = strings.TrimSpace(cc.userConfig.GetString(configKeyBackgroundLighting))
+	snapshot.Animations = cc.parseAnimations()
+	snapshot.Commands = cc.parseCommands()
+	snapshot.Gestures = cc.parseGestures()
+
+	snapshot.CommandExecutor = strings.ToLower(strings.TrimSpace(cc.userConfig.GetString(configKeyCommandExecutor)))
+	if snapshot.CommandExecutor != commandExecutorSpawn && snapshot.CommandExecutor != commandExecutorPersistent {
+		cc.logger.Warnw("Invalid command executor specified, using default value",
+			"key", configKeyCommandExecutor,
+			"invalidValue", snapshot.CommandExecutor,
+			"defaultValue", commandExecutorSpawn)
+
+		snapshot.CommandExecutor = commandExecutorSpawn
 	}
-	cc.BackgroundLighting = strings.TrimSpace(cc.userConfig.GetString(configKeyBackgroundLighting))
-	cc.Commands = cc.parseCommands()
 
+	cc.publish(snapshot)
 	cc.logger.Debug("Populated config fields from vipers")
 
 	return nil
 }
 
-func (cc *CanonicalConfig) inferSliderCount() int {
+func inferSliderCount(snapshot *ConfigSnapshot) int {
 	maxSliderIdx := -1
-	cc.SliderMapping.iterate(func(sliderIdx int, _ []string) {
+	snapshot.SliderMapping.iterate(func(sliderIdx int, _ []string) {
 		if sliderIdx > maxSliderIdx {
 			maxSliderIdx = sliderIdx
 		}
 	})
 
-	for sliderIdx := range cc.ColorMapping {
+	for sliderIdx := range snapshot.ColorMapping {
 		if sliderIdx > maxSliderIdx {
 			maxSliderIdx = sliderIdx
 		}
@@ -360,6 +464,163 @@ func (cc *CanonicalConfig) parseColorMapping() map[int]SliderColorConfig {
 	return result
 }
 
+// parseControllers reads the controllers list. without one, there's a single controller on the given port
+func (cc *CanonicalConfig) parseControllers(comPort string, baudRate int) []ControllerConfig {
+	single := []ControllerConfig{{
+		COMPort:  comPort,
+		BaudRate: baudRate,
+	}}
+
+	raw := []ControllerConfig{}
+	if err := cc.userConfig.UnmarshalKey(configKeyControllers, &raw); err != nil {
+		cc.logger.Warnw("Failed to parse controllers from config, using com_port", "error", err)
+		return single
+	}
+
+	if len(raw) == 0 {
+		return single
+	}
+
+	result := make([]ControllerConfig, 0, len(raw))
+	seenPorts := make(map[string]bool)
+
+	for _, controller := range raw {
+		controller.COMPort = strings.TrimSpace(controller.COMPort)
+		if controller.COMPort == "" {
+			cc.logger.Warnw("Ignoring controller entry without a COM port", "controller", controller)
+			continue
+		}
+
+		if seenPorts[strings.ToLower(controller.COMPort)] {
+			cc.logger.Warnw("Ignoring duplicate controller entry", "comPort", controller.COMPort)
+			continue
+		}
+		seenPorts[strings.ToLower(controller.COMPort)] = true
+
+		if controller.BaudRate <= 0 {
+			controller.BaudRate = baudRate
+		}
+
+		if controller.SliderOffset < 0 {
+			cc.logger.Warnw("Invalid slider offset specified, using 0",
+				"comPort", controller.COMPort,
+				"invalidValue", controller.SliderOffset)
+
+			controller.SliderOffset = 0
+		}
+
+		if controller.Sliders < 0 {
+			controller.Sliders = 0
+		}
+
+		result = append(result, controller)
+	}
+
+	if len(result) == 0 {
+		return single
+	}
+
+	sort.SliceStable(result, func(i, j int) bool {
+		return result[i].SliderOffset < result[j].SliderOffset
+	})
+
+	// every slider index belongs to a single controller, so windows can't overlap. a controller whose sliders
+	// run into the next controller's window is cut short, and one that shares another's offset is dropped
+	valid := result[:0]
+	for _, controller := range result {
+		if len(valid) > 0 {
+			previous := &valid[len(valid)-1]
+
+			if controller.SliderOffset == previous.SliderOffset {
+				cc.logger.Warnw("Ignoring controller entry whose slider offset is already taken",
+					"comPort", controller.COMPort,
+					"sliderOffset", controller.SliderOffset,
+					"takenBy", previous.COMPort)
+
+				continue
+			}
+
+			if previous.Sliders > 0 && previous.SliderOffset+previous.Sliders > controller.SliderOffset {
+				cc.logger.Warnw("Controller's sliders overlap the next controller's, limiting them",
+					"comPort", previous.COMPort,
+					"invalidValue", previous.Sliders,
+					"limitedTo", controller.SliderOffset-previous.SliderOffset,
+					"nextComPort", controller.COMPort)
+
+				previous.Sliders = controller.SliderOffset - previous.SliderOffset
+			}
+		}
+
+		valid = append(valid, controller)
+	}
+
+	return valid
+}
+
+// parseAnimations reads the animations list. leds is "backlight", "buttons", "ring<n>" or "<first>-<last>"
+// (1-based LED numbers), trigger is "always", "button[<n>]" or "mute[<n>]". invalid entries are dropped
+func (cc *CanonicalConfig) parseAnimations() []AnimationConfig {
+	raw := []AnimationConfig{}
+	if err := cc.userConfig.UnmarshalKey(configKeyAnimations, &raw); err != nil {
+		cc.logger.Warnw("Failed to parse animations from config", "error", err)
+		return nil
+	}
+
+	result := make([]AnimationConfig, 0, len(raw))
+
+	for idx, animation := range raw {
+		animation.LEDs = strings.ToLower(strings.ReplaceAll(animation.LEDs, " ", ""))
+		animation.Trigger = strings.ToLower(strings.ReplaceAll(animation.Trigger, " ", ""))
+		if animation.Trigger == "" {
+			animation.Trigger = "always"
+		}
+
+		if !animationLEDsPattern.MatchString(animation.LEDs) {
+			cc.logger.Warnw("Ignoring animation with invalid leds", "animation", idx, "leds", animation.LEDs)
+			continue
+		}
+
+		if !animationTriggerPattern.MatchString(animation.Trigger) {
+			cc.logger.Warnw("Ignoring animation with invalid trigger", "animation", idx, "trigger", animation.Trigger)
+			continue
+		}
+
+		if len(animation.Keyframes) == 0 || len(animation.Keyframes) > maxAnimationKeyframes {
+			cc.logger.Warnw("Ignoring animation with an invalid number of keyframes",
+				"animation", idx,
+				"keyframes", len(animation.Keyframes),
+				"max", maxAnimationKeyframes)
+			continue
+		}
+
+		valid := true
+		for keyIdx := range animation.Keyframes {
+			keyframe := &animation.Keyframes[keyIdx]
+			keyframe.Color = strings.TrimSpace(keyframe.Color)
+
+			if keyframe.At < 0 || keyframe.At > maxAnimationMillis || !isHexColor(keyframe.Color) ||
+				(keyIdx > 0 && keyframe.At < animation.Keyframes[keyIdx-1].At) {
+				valid = false
+				break
+			}
+		}
+
+		if !valid {
+			cc.logger.Warnw("Ignoring animation with invalid keyframes (ascending times up to 65535ms, #rrggbb colors)", "animation", idx)
+			continue
+		}
+
+		if len(result) == maxAnimations {
+			cc.logger.Warnw("Ignoring animations past the controller's limit", "max", maxAnimations)
+			break
+		}
+
+		result = append(result, animation)
+	}
+
+	return result
+}
+
 func (cc *CanonicalConfig) parseCommands() map[int]CommandSpec {
 	result := make(map[int]CommandSpec)
 
@@ -382,6 +643,29 @@ func (cc *CanonicalConfig) parseCommands() map[int]CommandSpec {
 	return result
 }
 
+// parseGestures reads the commands run for controller gestures, keyed by gesture name (see normalizeGestureName)
+func (cc *CanonicalConfig) parseGestures() map[string]CommandSpec {
+	result := make(map[string]CommandSpec)
+
+	raw := cc.userConfig.GetStringMap(configKeyGestures)
+	for key, value := range raw {
+		name, err := normalizeGestureName(key)
+		if err != nil {
+			cc.logger.Warnw("Ignoring gesture entry with invalid name", "key", key, "error", err)
+			continue
+		}
+
+		spec, ok := cc.parseCommandValue(value)
+		if !ok {
+			continue
+		}
+
+		result[name] = spec
+	}
+
+	return result
+}
+
 func (cc *CanonicalConfig) parseCommandValue(value interface{}) (CommandSpec, bool) {
 	switch typed := value.(type) {
 	case string:
@@ -446,6 +730,11 @@ func (cc *CanonicalConfig) parseCommandValue(value interface{}) (CommandSpec, bo
 func (cc *CanonicalConfig) parseCommandMap(value map[string]interface{}) (CommandSpec, bool) {
 	spec := CommandSpec{}
 
+	// optional built-in action: { action: default_sink, device: <name>, move_streams: true }
+	if actionValue, ok := value["action"]; ok {
+		return cc.parseCommandAction(actionValue, value)
+	}
+
 	if shellValue, ok := value["shell"]; ok {
 		if shellBool, ok := shellValue.(bool); ok {
 			spec.Shell = shellBool
@@ -497,6 +786,38 @@ func (cc *CanonicalConfig) parseCommandMap(value map[string]interface{}) (Comman
 	return spec, true
 }
 
+func (cc *CanonicalConfig) parseCommandAction(actionValue interface{}, value map[string]interface{}) (CommandSpec, bool) {
+	action, ok := actionValue.(string)
+	if !ok {
+		cc.logger.Warnw("Ignoring command entry with non-string action", "value", actionValue)
+		return CommandSpec{}, false
+	}
+
+	spec := CommandSpec{Action: strings.ToLower(strings.TrimSpace(action))}
+	if spec.Action != commandActionDefaultSink && spec.Action != commandActionDefaultSource {
+		cc.logger.Warnw("Ignoring command entry with unknown action", "action", action)
+		return CommandSpec{}, false
+	}
+
+	device, ok := value["device"].(string)
+	if !ok || strings.TrimSpace(device) == "" {
+		cc.logger.Warnw("Ignoring command action without a device name", "action", spec.Action)
+		return CommandSpec{}, false
+	}
+	spec.Device = strings.TrimSpace(device)
+
+	if moveValue, ok := value["move_streams"]; ok {
+		moveStreams, ok := moveValue.(bool)
+		if !ok {
+			cc.logger.Warnw("Ignoring command entry with non-bool move_streams flag", "value", moveValue)
+			return CommandSpec{}, false
+		}
+		spec.MoveStreams = moveStreams
+	}
+
+	return spec, true
+}
+
 func (cc *CanonicalConfig) captureConfigFingerprint() {
 	content, err := ioutil.ReadFile(userConfigFilepath)
 	if err != nil {
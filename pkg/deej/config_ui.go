@@ -8,6 +8,7 @@ import (
 	"io/ioutil"
 	"net"
 	"net/http"
+	"net/http/pprof"
 	"os"
 	"os/exec"
 	"path/filepath"
@@ -27,6 +28,10 @@ import (
 const (
 	configUIProfilesDir      = "profiles"
 	configUIDefaultSliderCap = 32
+
+	// when this is set to anything, the config UI server also serves go's profiling endpoints (under /debug/pprof/),
+	// and is started together with deej instead of on first use so it can be profiled from the start
+	envConfigUIPprof = "DEEJ_PPROF"
 )
 
 var (
@@ -44,6 +49,10 @@ type configUIService struct {
 
 	listener net.Listener
 	server   *http.Server
+
+	live *configUILive
+
+	pprof bool
 }
 
 type configUIStateResponse struct {
@@ -69,6 +78,29 @@ type configUIConfig struct {
 	BackgroundLighting string                            `json:"backgroundLighting"`
 	ColorMapping       map[string]configUISliderColorMap `json:"colorMapping"`
 	Commands           interface{}                       `json:"commands,omitempty"`
+	Gestures           interface{}                       `json:"gestures,omitempty"`
+	CommandExecutor    string                            `json:"commandExecutor,omitempty"`
+	Controllers        []configUIController              `json:"controllers,omitempty"`
+	Animations         []configUIAnimation               `json:"animations,omitempty"`
+}
+
+type configUIController struct {
+	COMPort      string `json:"comPort"`
+	BaudRate     int    `json:"baudRate,omitempty"`
+	SliderOffset int    `json:"sliderOffset"`
+	Sliders      int    `json:"sliders,omitempty"`
+}
+
+type configUIAnimation struct {
+	LEDs      string                      `json:"leds"`
+	Trigger   string                      `json:"trigger,omitempty"`
+	Loop      bool                        `json:"loop"`
+	Keyframes []configUIAnimationKeyframe `json:"keyframes"`
+}
+
+type configUIAnimationKeyframe struct {
+	At    int    `json:"at"`
+	Color string `json:"color"`
 }
 
 type configUISliderColorMap struct {
@@ -105,9 +137,22 @@ func newConfigUIService(d *Deej, logger *zap.SugaredLogger) *configUIService {
 	return &configUIService{
 		deej:   d,
 		logger: logger.Named("config-ui"),
+		live:   newConfigUILive(),
+		pprof:  os.Getenv(envConfigUIPprof) != "",
 	}
 }
 
+// onSliderValues updates the live knob positions shown in the UI. this is called from the serial
+// read loop, so it only copies into a cached snapshot and wakes any connected clients
+func (s *configUIService) onSliderValues(values []float32) {
+	s.live.updateSliders(values)
+}
+
+// onSessionsChanged updates the cached list of application targets after the session map is rebuilt
+func (s *configUIService) onSessionsChanged(keys []string) {
+	s.live.updateSessions(keys)
+}
+
 func (s *configUIService) Open() error {
 	s.mu.Lock()
 	if !s.started {
@@ -126,6 +171,22 @@ func (s *configUIService) Open() error {
 	return nil
 }
 
+// StartProfiling starts the config UI server ahead of time, if the profiling endpoint was requested
+func (s *configUIService) StartProfiling() error {
+	if !s.pprof {
+		return nil
+	}
+
+	s.mu.Lock()
+	defer s.mu.Unlock()
+
+	if s.started {
+		return nil
+	}
+
+	return s.startLocked()
+}
+
 func (s *configUIService) Stop() {
 	s.mu.Lock()
 	server := s.server
@@ -150,10 +211,20 @@ func (s *configUIService) startLocked() error {
 	mux := http.NewServeMux()
 	mux.HandleFunc("/", s.handleIndex)
 	mux.HandleFunc("/api/state", s.handleState)
+	mux.HandleFunc("/api/live", s.handleLive)
 	mux.HandleFunc("/api/save", s.handleSave)
 	mux.HandleFunc("/api/profiles/save", s.handleSaveProfile)
 	mux.HandleFunc("/api/profiles/load", s.handleLoadProfile)
 
+	// the server only listens on loopback, but profiling is still strictly opt-in
+	if s.pprof {
+		mux.HandleFunc("/debug/pprof/", pprof.Index)
+		mux.HandleFunc("/debug/pprof/cmdline", pprof.Cmdline)
+		mux.HandleFunc("/debug/pprof/profile", pprof.Profile)
+		mux.HandleFunc("/debug/pprof/symbol", pprof.Symbol)
+		mux.HandleFunc("/debug/pprof/trace", pprof.Trace)
+	}
+
 	listener, err := net.Listen("tcp", "127.0.0.1:0")
 	if err != nil {
 		return fmt.Errorf("listen for config ui: %w", err)
@@ -171,6 +242,10 @@ func (s *configUIService) startLocked() error {
 	}()
 
 	s.logger.Infow("Started configuration UI server", "url", s.url)
+	if s.pprof {
+		s.logger.Infow("Serving profiling endpoint", "url", s.url+"/debug/pprof/")
+	}
+
 	return nil
 }
 
@@ -190,11 +265,14 @@ func (s *configUIService) handleState(w http.ResponseWriter, r *http.Request) {
 		return
 	}
 
+	// only hit the system when the user explicitly asks for a rescan (or on the very first load)
+	rescan := r.URL.Query().Get("rescan") == "1"
+
 	state := configUIStateResponse{
 		Config:          s.currentConfig(),
-		Applications:    s.applicationTargets(),
-		SerialPorts:     listSerialPorts(),
-		Profiles:        listProfiles(),
+		Applications:    s.applicationTargets(rescan),
+		SerialPorts:     s.serialPorts(rescan),
+		Profiles:        s.profiles(),
 		SpecialTargets:  []string{"master", "mic", "system", "deej.current", "deej.unmapped"},
 		BaudRateOptions: []int{9600, 19200, 38400, 57600, 115200, 230400},
 		ColorPresets: []configUIColorPreset{
@@ -266,6 +344,8 @@ func (s *configUIService) handleSaveProfile(w http.ResponseWriter, r *http.Reque
 		return
 	}
 
+	s.live.updateProfiles(listProfiles())
+
 	writeJSON(w, http.StatusOK, map[string]bool{"saved": true})
 }
 
@@ -303,22 +383,58 @@ func (s *configUIService) handleLoadProfile(w http.ResponseWriter, r *http.Reque
 }
 
 func (s *configUIService) currentConfig() configUIConfig {
+	snapshot := s.deej.config.Snapshot()
+
 	cfg := configUIConfig{
-		SliderCount:        s.deej.config.SliderCount,
+		SliderCount:        snapshot.SliderCount,
 		SliderMapping:      map[string][]string{},
-		COMPort:            s.deej.config.ConnectionInfo.COMPort,
-		BaudRate:           s.deej.config.ConnectionInfo.BaudRate,
-		InvertSliders:      s.deej.config.InvertSliders,
-		NoiseReduction:     s.deej.config.NoiseReductionLevel,
-		SendOnStartup:      s.deej.config.SendOnStartup,
-		SyncVolumes:        s.deej.config.SyncVolumes,
-		BackgroundLighting: s.deej.config.BackgroundLighting,
+		COMPort:            snapshot.ConnectionInfo.COMPort,
+		BaudRate:           snapshot.ConnectionInfo.BaudRate,
+		InvertSliders:      snapshot.InvertSliders,
+		NoiseReduction:     snapshot.NoiseReductionLevel,
+		SendOnStartup:      snapshot.SendOnStartup,
+		SyncVolumes:        snapshot.SyncVolumes,
+		BackgroundLighting: snapshot.BackgroundLighting,
 		ColorMapping:       map[string]configUISliderColorMap{},
 		Commands:           s.deej.config.userConfig.Get(configKeyCommands),
+		Gestures:           s.deej.config.userConfig.Get(configKeyGestures),
+		CommandExecutor:    snapshot.CommandExecutor,
+	}
+
+	// a "controllers" list isn't edited in the UI, but it has to survive saving
+	rawControllers := []ControllerConfig{}
+	if err := s.deej.config.userConfig.UnmarshalKey(configKeyControllers, &rawControllers); err == nil {
+		for _, controller := range rawControllers {
+			cfg.Controllers = append(cfg.Controllers, configUIController{
+				COMPort:      controller.COMPort,
+				BaudRate:     controller.BaudRate,
+				SliderOffset: controller.SliderOffset,
+				Sliders:      controller.Sliders,
+			})
+		}
+	}
+
+	// neither are animations
+	rawAnimations := []AnimationConfig{}
+	if err := s.deej.config.userConfig.UnmarshalKey(configKeyAnimations, &rawAnimations); err == nil {
+		for _, animation := range rawAnimations {
+			uiAnimation := configUIAnimation{
+				LEDs:      animation.LEDs,
+				Trigger:   animation.Trigger,
+				Loop:      animation.Loop,
+				Keyframes: []configUIAnimationKeyframe{},
+			}
+
+			for _, keyframe := range animation.Keyframes {
+				uiAnimation.Keyframes = append(uiAnimation.Keyframes, configUIAnimationKeyframe{At: keyframe.At, Color: keyframe.Color})
+			}
+
+			cfg.Animations = append(cfg.Animations, uiAnimation)
+		}
 	}
 
 	maxIndex := -1
-	s.deej.config.SliderMapping.iterate(func(sliderIdx int, targets []string) {
+	snapshot.SliderMapping.iterate(func(sliderIdx int, targets []string) {
 		cleanTargets := make([]string, len(targets))
 		copy(cleanTargets, targets)
 		cfg.SliderMapping[strconv.Itoa(sliderIdx)] = cleanTargets
@@ -327,7 +443,7 @@ func (s *configUIService) currentConfig() configUIConfig {
 		}
 	})
 
-	for idx, entry := range s.deej.config.ColorMapping {
+	for idx, entry := range snapshot.ColorMapping {
 		mode := "gradient"
 		if strings.EqualFold(strings.TrimSpace(entry.Zero), strings.TrimSpace(entry.Full)) {
 			mode = "single"
@@ -356,20 +472,41 @@ func (s *configUIService) currentConfig() configUIConfig {
 	return cfg
 }
 
-func (s *configUIService) applicationTargets() []string {
-	s.deej.sessions.refreshSessions(true)
-	keys := s.deej.sessions.listSessionKeys()
-	result := make([]string, 0, len(keys))
+// applicationTargets returns the cached application list, which the session map keeps up to date.
+// the session map is only re-enumerated when the user explicitly asks for a rescan
+func (s *configUIService) applicationTargets(rescan bool) []string {
+	if rescan {
 
-	for _, key := range keys {
-		if key == masterSessionName || key == inputSessionName || key == systemSessionName {
-			continue
+		// performance: the reason that forcing a refresh here is okay is that it only happens
+		// when the user clicks the reload button in the UI
+		s.deej.sessions.refreshSessions(true)
+	}
+
+	return s.live.cachedApplications()
+}
+
+func (s *configUIService) serialPorts(rescan bool) []configUIPortOption {
+	if !rescan {
+		if ports, ok := s.live.cachedSerialPorts(); ok {
+			return ports
 		}
-		result = append(result, key)
 	}
 
-	sort.Strings(result)
-	return result
+	ports := listSerialPorts()
+	s.live.updateSerialPorts(ports)
+
+	return ports
+}
+
+func (s *configUIService) profiles() []string {
+	if profiles, ok := s.live.cachedProfiles(); ok {
+		return profiles
+	}
+
+	profiles := listProfiles()
+	s.live.updateProfiles(profiles)
+
+	return profiles
 }
 
 func writeJSON(w http.ResponseWriter, status int, payload interface{}) {
@@ -462,6 +599,21 @@ func saveConfigToPath(config configUIConfig, targetPath string) error {
 	fmt.Fprintf(buf, "com_port: %s\n", yamlString(comPort))
 	fmt.Fprintf(buf, "baud_rate: %d\n", normalizeBaudRate(config.BaudRate))
 
+	if len(config.Controllers) > 0 {
+		buf.WriteString("# multiple controllers (not edited in UI, replaces com_port when set)\n")
+		buf.WriteString("controllers:\n")
+		for _, controller := range config.Controllers {
+			fmt.Fprintf(buf, "  - com_port: %s\n", yamlString(strings.TrimSpace(controller.COMPort)))
+			if controller.BaudRate > 0 {
+				fmt.Fprintf(buf, "    baud_rate: %d\n", normalizeBaudRate(controller.BaudRate))
+			}
+			fmt.Fprintf(buf, "    slider_offset: %d\n", controller.SliderOffset)
+			if controller.Sliders > 0 {
+				fmt.Fprintf(buf, "    sliders: %d\n", controller.Sliders)
+			}
+		}
+	}
+
 	buf.WriteString("\n# --- Bidirectional Sync Settings ---\n")
 	fmt.Fprintf(buf, "send_on_startup: %t\n", config.SendOnStartup)
 	fmt.Fprintf(buf, "sync_volumes: %t\n", config.SyncVolumes)
@@ -485,14 +637,46 @@ func saveConfigToPath(config configUIConfig, targetPath string) error {
 		}
 	}
 
-	if config.Commands != nil {
+	if len(config.Animations) > 0 {
+		buf.WriteString("# keyframed animations (not edited in UI)\n")
+		buf.WriteString("animations:\n")
+		for _, animation := range config.Animations {
+			fmt.Fprintf(buf, "  - leds: %s\n", yamlString(strings.TrimSpace(animation.LEDs)))
+			if trigger := strings.TrimSpace(animation.Trigger); trigger != "" {
+				fmt.Fprintf(buf, "    trigger: %s\n", yamlString(trigger))
+			}
+			fmt.Fprintf(buf, "    loop: %t\n", animation.Loop)
+			buf.WriteString("    keyframes:\n")
+			for _, keyframe := range animation.Keyframes {
+				fmt.Fprintf(buf, "      - at: %d\n", keyframe.At)
+				fmt.Fprintf(buf, "        color: %s\n", yamlString(strings.TrimSpace(keyframe.Color)))
+			}
+		}
+	}
+
+	commandExecutor := strings.TrimSpace(strings.ToLower(config.CommandExecutor))
+	if config.Commands != nil || config.Gestures != nil || (commandExecutor != "" && commandExecutor != commandExecutorSpawn) {
 		buf.WriteString("\n# --- Commands (not edited in UI) ---\n")
+	}
+
+	if commandExecutor == commandExecutorPersistent {
+		fmt.Fprintf(buf, "command_executor: %s\n", yamlString(commandExecutor))
+	}
+
+	if config.Commands != nil {
 		commandsDoc, err := yaml.Marshal(map[string]interface{}{configKeyCommands: config.Commands})
 		if err == nil {
 			buf.Write(commandsDoc)
 		}
 	}
 
+	if config.Gestures != nil {
+		gesturesDoc, err := yaml.Marshal(map[string]interface{}{configKeyGestures: config.Gestures})
+		if err == nil {
+			buf.Write(gesturesDoc)
+		}
+	}
+
 	return ioutil.WriteFile(targetPath, buf.Bytes(), 0644)
 }
 
@@ -0,0 +1,339 @@
+package deej
+
+import (
+	"encoding/json"
+	"fmt"
+	"net/http"
+	"sort"
+	"sync"
+	"time"
+)
+
+const (
+
+	// how often device statistics are re-checked while at least one live client is connected.
+	// a change in a device's state (connection, sliders, link health) is pushed on the next check
+	configUILiveStatsInterval = time.Second
+
+	// traffic counters (lines, moves, commands, pings) change with every keepalive line from a controller.
+	// when they're all that changed, devices are pushed at most this often
+	configUILiveCountersInterval = 10 * time.Second
+
+	// keeps idle proxies and browsers from dropping an otherwise quiet event stream
+	configUILiveKeepAliveInterval = 20 * time.Second
+)
+
+// configUILive holds cached snapshots of everything the config UI displays, and fans out
+// change notifications to connected event stream clients. producers (serial, session map, UI handlers)
+// update the snapshots incrementally, so serving the UI never triggers port or session enumeration
+type configUILive struct {
+	mu sync.Mutex
+
+	sliders        []float32
+	slidersVersion uint64
+
+	applications        []string
+	applicationsVersion uint64
+
+	serialPorts     []configUIPortOption
+	serialPortsSet  bool
+	profiles        []string
+	profilesSet     bool
+	profilesVersion uint64
+
+	subscribers map[chan struct{}]struct{}
+}
+
+// configUILiveCursor tracks which snapshot versions a single client has already received
+type configUILiveCursor struct {
+	slidersVersion      uint64
+	applicationsVersion uint64
+	profilesVersion     uint64
+	stats               []serialStatsSnapshot
+	statsSentAt         time.Time
+}
+
+type configUILiveSliders struct {
+	Values []float32 `json:"values"`
+}
+
+func newConfigUILive() *configUILive {
+	return &configUILive{
+		subscribers: make(map[chan struct{}]struct{}),
+	}
+}
+
+func (l *configUILive) subscribe() chan struct{} {
+	ch := make(chan struct{}, 1)
+
+	l.mu.Lock()
+	l.subscribers[ch] = struct{}{}
+	l.mu.Unlock()
+
+	return ch
+}
+
+func (l *configUILive) unsubscribe(ch chan struct{}) {
+	l.mu.Lock()
+	delete(l.subscribers, ch)
+	l.mu.Unlock()
+}
+
+// notifyLocked wakes all subscribers without blocking. a subscriber that hasn't consumed
+// its previous wakeup yet will pick up every pending change in one go
+func (l *configUILive) notifyLocked() {
+	for ch := range l.subscribers {
+		select {
+		case ch <- struct{}{}:
+		default:
+		}
+	}
+}
+
+func (l *configUILive) updateSliders(values []float32) {
+	l.mu.Lock()
+	defer l.mu.Unlock()
+
+	// reuse the snapshot's backing array, this runs on the serial hot path
+	if cap(l.sliders) < len(values) {
+		l.sliders = make([]float32, len(values))
+	}
+	l.sliders = l.sliders[:len(values)]
+	copy(l.sliders, values)
+
+	l.slidersVersion++
+	l.notifyLocked()
+}
+
+func (l *configUILive) updateSessions(keys []string) {
+	applications := make([]string, 0, len(keys))
+	for _, key := range keys {
+		if key == masterSessionName || key == inputSessionName || key == systemSessionName {
+			continue
+		}
+		applications = append(applications, key)
+	}
+
+	sort.Strings(applications)
+
+	l.mu.Lock()
+	defer l.mu.Unlock()
+
+	if stringSlicesEqual(l.applications, applications) && l.applicationsVersion > 0 {
+		return
+	}
+
+	l.applications = applications
+	l.applicationsVersion++
+	l.notifyLocked()
+}
+
+func (l *configUILive) updateProfiles(profiles []string) {
+	l.mu.Lock()
+	defer l.mu.Unlock()
+
+	l.profiles = profiles
+	l.profilesSet = true
+	l.profilesVersion++
+	l.notifyLocked()
+}
+
+func (l *configUILive) updateSerialPorts(ports []configUIPortOption) {
+	l.mu.Lock()
+	defer l.mu.Unlock()
+
+	l.serialPorts = ports
+	l.serialPortsSet = true
+}
+
+func (l *configUILive) cachedApplications() []string {
+	l.mu.Lock()
+	defer l.mu.Unlock()
+
+	return append([]string{}, l.applications...)
+}
+
+func (l *configUILive) cachedProfiles() ([]string, bool) {
+	l.mu.Lock()
+	defer l.mu.Unlock()
+
+	return append([]string{}, l.profiles...), l.profilesSet
+}
+
+func (l *configUILive) cachedSerialPorts() ([]configUIPortOption, bool) {
+	l.mu.Lock()
+	defer l.mu.Unlock()
+
+	return append([]configUIPortOption{}, l.serialPorts...), l.serialPortsSet
+}
+
+func (s *configUIService) handleLive(w http.ResponseWriter, r *http.Request) {
+	if r.Method != http.MethodGet {
+		http.Error(w, "method not allowed", http.StatusMethodNotAllowed)
+		return
+	}
+
+	flusher, ok := w.(http.Flusher)
+	if !ok {
+		http.Error(w, "streaming unsupported", http.StatusInternalServerError)
+		return
+	}
+
+	w.Header().Set("Content-Type", "text/event-stream")
+	w.Header().Set("Cache-Control", "no-cache")
+	w.Header().Set("Connection", "keep-alive")
+	w.WriteHeader(http.StatusOK)
+
+	wakeup := s.live.subscribe()
+	defer s.live.unsubscribe(wakeup)
+
+	statsTicker := time.NewTicker(configUILiveStatsInterval)
+	defer statsTicker.Stop()
+
+	keepAliveTicker := time.NewTicker(configUILiveKeepAliveInterval)
+	defer keepAliveTicker.Stop()
+
+	cursor := configUILiveCursor{}
+
+	for {
+		if err := s.writeLiveUpdates(w, &cursor); err != nil {
+			s.logger.Debugw("Live client went away", "error", err)
+			return
+		}
+		flusher.Flush()
+
+		select {
+		case <-r.Context().Done():
+			return
+		case <-wakeup:
+		case <-statsTicker.C:
+		case <-keepAliveTicker.C:
+			if _, err := fmt.Fprint(w, ": keep-alive\n\n"); err != nil {
+				return
+			}
+		}
+	}
+}
+
+// writeLiveUpdates sends every snapshot section that changed since the client's cursor
+func (s *configUIService) writeLiveUpdates(w http.ResponseWriter, cursor *configUILiveCursor) error {
+	s.live.mu.Lock()
+
+	var sliders *configUILiveSliders
+	if s.live.slidersVersion != cursor.slidersVersion {
+		sliders = &configUILiveSliders{Values: append([]float32{}, s.live.sliders...)}
+		cursor.slidersVersion = s.live.slidersVersion
+	}
+
+	var applications []string
+	if s.live.applicationsVersion != cursor.applicationsVersion {
+		applications = append([]string{}, s.live.applications...)
+		cursor.applicationsVersion = s.live.applicationsVersion
+	}
+
+	var profiles []string
+	if s.live.profilesVersion != cursor.profilesVersion {
+		profiles = append([]string{}, s.live.profiles...)
+		cursor.profilesVersion = s.live.profilesVersion
+	}
+
+	s.live.mu.Unlock()
+
+	if sliders != nil {
+		if err := writeServerSentEvent(w, "sliders", sliders); err != nil {
+			return err
+		}
+	}
+
+	if applications != nil {
+		if err := writeServerSentEvent(w, "applications", applications); err != nil {
+			return err
+		}
+	}
+
+	if profiles != nil {
+		if err := writeServerSentEvent(w, "profiles", profiles); err != nil {
+			return err
+		}
+	}
+
+	stats := s.deej.serial.Stats()
+	countersDue := time.Since(cursor.statsSentAt) >= configUILiveCountersInterval
+	if cursor.statsSentAt.IsZero() || serialStatesChanged(stats, cursor.stats) ||
+		(countersDue && !serialStatsEqual(stats, cursor.stats)) {
+
+		if err := writeServerSentEvent(w, "devices", stats); err != nil {
+			return err
+		}
+
+		cursor.stats = stats
+		cursor.statsSentAt = time.Now()
+	}
+
+	return nil
+}
+
+func writeServerSentEvent(w http.ResponseWriter, event string, payload interface{}) error {
+	data, err := json.Marshal(payload)
+	if err != nil {
+		return fmt.Errorf("marshal %s event: %w", event, err)
+	}
+
+	_, err = fmt.Fprintf(w, "event: %s\ndata: %s\n\n", event, data)
+	return err
+}
+
+func stringSlicesEqual(a []string, b []string) bool {
+	if len(a) != len(b) {
+		return false
+	}
+
+	for idx := range a {
+		if a[idx] != b[idx] {
+			return false
+		}
+	}
+
+	return true
+}
+
+// serialStatesChanged tells whether any device's state changed, ignoring its traffic counters
+func serialStatesChanged(a []serialStatsSnapshot, b []serialStatsSnapshot) bool {
+	if len(a) != len(b) {
+		return true
+	}
+
+	for idx := range a {
+		if withoutTrafficCounters(a[idx]) != withoutTrafficCounters(b[idx]) {
+			return true
+		}
+	}
+
+	return false
+}
+
+func withoutTrafficCounters(stats serialStatsSnapshot) serialStatsSnapshot {
+	stats.LinesRead = 0
+	stats.MoveEvents = 0
+	stats.Commands = 0
+	stats.LastLineAt = 0
+	stats.Link.PingsSent = 0
+	stats.Link.RTTMicros = 0
+	stats.Link.JitterMicros = 0
+
+	return stats
+}
+
+func serialStatsEqual(a []serialStatsSnapshot, b []serialStatsSnapshot) bool {
+	if len(a) != len(b) {
+		return false
+	}
+
+	for idx := range a {
+		if a[idx] != b[idx] {
+			return false
+		}
+	}
+
+	return true
+}
@@ -31,6 +31,10 @@ const configUIHTML = `<!doctype html>
     .actions button { flex: 1; }
     .muted { color: #9aa0a6; font-size: 12px; }
     #status { margin-bottom: 12px; font-size: 13px; color: #9ecbff; }
+    .meter { display: flex; align-items: center; gap: 8px; margin-bottom: 6px; font-size: 12px; }
+    .meter .bar { flex: 1; height: 10px; background: #111; border: 1px solid #444; border-radius: 6px; overflow: hidden; }
+    .meter .fill { height: 100%; background: #2f6feb; width: 0; }
+    .meter .value { width: 40px; text-align: right; }
   </style>
 </head>
 <body>
@@ -38,6 +42,12 @@ const configUIHTML = `<!doctype html>
     <h1>deej configuration</h1>
     <div id="status">Loading...</div>
 
+    <section>
+      <h2>Live</h2>
+      <div class="muted" id="deviceStatus">Waiting for device...</div>
+      <div id="liveSliders" style="margin-top:8px;"></div>
+    </section>
+
     <section>
       <h2>Profiles</h2>
       <div class="row">
@@ -352,12 +362,16 @@ const configUIHTML = `<!doctype html>
         backgroundLighting: byId('bgPreset').value === 'custom' ? byId('bgCustom').value : byId('bgPreset').value,
         colorMapping,
         commands: state.config.commands,
+        gestures: state.config.gestures,
+        commandExecutor: state.config.commandExecutor,
+        controllers: state.config.controllers,
+        animations: state.config.animations,
       };
     }
 
-    async function loadState() {
-      status('Loading state...');
-      state = await request('/api/state');
+    async function loadState(rescan = false) {
+      status(rescan ? 'Rescanning ports and sessions...' : 'Loading state...');
+      state = await request('/api/state' + (rescan ? '?rescan=1' : ''));
 
       byId('sliderCount').value = state.config.sliderCount;
       byId('comPort').value = state.config.comPort || '';
@@ -412,7 +426,7 @@ const configUIHTML = `<!doctype html>
     }
 
     byId('save').onclick = () => saveConfig().catch((err) => status(err.message, true));
-    byId('reload').onclick = () => loadState().catch((err) => status(err.message, true));
+    byId('reload').onclick = () => loadState(true).catch((err) => status(err.message, true));
     byId('saveProfile').onclick = () => saveProfile().catch((err) => status(err.message, true));
     byId('loadProfile').onclick = () => loadProfile().catch((err) => status(err.message, true));
 
@@ -435,7 +449,90 @@ const configUIHTML = `<!doctype html>
       renderColors();
     };
 
-    loadState().catch((err) => status(err.message, true));
+    function renderLiveSliders(values) {
+      const wrap = byId('liveSliders');
+      if (wrap.children.length !== values.length) {
+        wrap.innerHTML = '';
+        values.forEach((_, i) => {
+          const row = document.createElement('div');
+          row.className = 'meter';
+          row.innerHTML = '<span>Slider ' + i + '</span><div class="bar"><div class="fill" id="live-fill-' + i + '"></div></div><span class="value" id="live-value-' + i + '"></span>';
+          wrap.appendChild(row);
+        });
+      }
+      values.forEach((value, i) => {
+        const percent = Math.round(Math.max(0, value) * 100);
+        byId('live-fill-' + i).style.width = percent + '%';
+        byId('live-value-' + i).textContent = value < 0 ? '-' : percent + '%';
+      });
+    }
+
+    function describeDevice(device) {
+      if (!device.connected) {
+        return 'Not connected' + (device.port ? ' (' + device.port + ')' : '');
+      }
+      const lastLine = device.lastLineAt ? Math.max(0, Date.now() - device.lastLineAt) + ' ms ago' : 'never';
+      const sliders = device.sliderOffset
+        ? 'sliders ' + device.sliderOffset + '-' + (device.sliderOffset + device.sliders - 1)
+        : device.sliders + ' sliders';
+      const link = device.link || {};
+      const health = link.stalled ? 'STALLED' : link.pingsSent && link.rttMicros
+        ? 'rtt ' + (link.rttMicros / 1000).toFixed(1) + ' ms \u00b1' + (link.jitterMicros / 1000).toFixed(1) +
+          ', ' + link.pingsLost + '/' + link.pingsSent + ' pings lost, ' + link.resyncs + ' resyncs'
+        : 'no ping replies';
+      return 'Connected to ' + device.port + ' - ' + sliders + ', ' +
+        device.linesRead + ' lines (' + device.malformedLines + ' malformed), ' + device.moveEvents + ' moves, ' +
+        device.commands + ' commands' + (link.stalled ? ', last line ' + lastLine : '') + ' - ' + health;
+    }
+
+    function renderDeviceStatus(devices) {
+      const status = byId('deviceStatus');
+      status.innerHTML = '';
+      if (!devices.length) {
+        status.textContent = 'No controllers configured';
+        return;
+      }
+      devices.forEach((device) => {
+        const line = document.createElement('div');
+        line.textContent = describeDevice(device);
+        status.appendChild(line);
+      });
+    }
+
+    function refreshSuggestions() {
+      const count = Number(byId('sliderCount').value || 1);
+      for (let i = 0; i < count; i++) {
+        const suggest = byId('suggest-' + i);
+        if (!suggest) continue;
+        const selected = suggest.value;
+        suggest.innerHTML = '';
+        [...state.specialTargets, ...state.applications].forEach((target) => {
+          const opt = document.createElement('option');
+          opt.value = target;
+          opt.textContent = target;
+          suggest.appendChild(opt);
+        });
+        suggest.value = selected;
+      }
+    }
+
+    function connectLive() {
+      const source = new EventSource('/api/live');
+      source.addEventListener('sliders', (e) => renderLiveSliders(JSON.parse(e.data).values));
+      source.addEventListener('devices', (e) => renderDeviceStatus(JSON.parse(e.data)));
+      source.addEventListener('applications', (e) => {
+        if (!state) return;
+        state.applications = JSON.parse(e.data);
+        refreshSuggestions();
+      });
+      source.addEventListener('profiles', (e) => {
+        if (!state) return;
+        state.profiles = JSON.parse(e.data);
+        renderProfiles();
+      });
+    }
+
+    loadState().then(connectLive).catch((err) => status(err.message, true));
   </script>
 </body>
 </html>
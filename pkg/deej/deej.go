@@ -23,10 +23,13 @@ type Deej struct {
 	logger   *zap.SugaredLogger
 	notifier Notifier
 	config   *CanonicalConfig
-	serial   *SerialIO
+	serial   *serialControllers
 	sessions *sessionMap
 	configUI *configUIService
 
+	shellWorkers  *shellWorkerPool
+	outputActions *outputActionQueues
+
 	stopChannel chan bool
 	version     string
 	verbose     bool
@@ -56,13 +59,7 @@ func NewDeej(logger *zap.SugaredLogger, verbose bool) (*Deej, error) {
 		verbose:     verbose,
 	}
 
-	serial, err := NewSerialIO(d, logger)
-	if err != nil {
-		logger.Errorw("Failed to create SerialIO", "error", err)
-		return nil, fmt.Errorf("create new SerialIO: %w", err)
-	}
-
-	d.serial = serial
+	d.serial = newSerialControllers(d, logger)
 
 	sessionFinder, err := newSessionFinder(logger)
 	if err != nil {
@@ -78,6 +75,8 @@ func NewDeej(logger *zap.SugaredLogger, verbose bool) (*Deej, error) {
 
 	d.sessions = sessions
 	d.configUI = newConfigUIService(d, logger)
+	d.shellWorkers = newShellWorkerPool(logger)
+	d.outputActions = newOutputActionQueues(d, logger)
 
 	logger.Debug("Created deej instance")
 
@@ -100,6 +99,8 @@ func (d *Deej) Initialize() error {
 		return fmt.Errorf("init session map: %w", err)
 	}
 
+	d.setupCommandExecutor()
+
 	// decide whether to run with/without tray
 	if _, noTraySet := os.LookupEnv(envNoTray); noTraySet {
 
@@ -143,31 +144,33 @@ func (d *Deej) run() {
 	// watch the config file for changes
 	go d.config.WatchConfigFileChanges()
 
-	// connect to the arduino for the first time
-	go func() {
-		if err := d.serial.Start(); err != nil {
-			d.logger.Warnw("Failed to start first-time serial connection", "error", err)
-
-			// If the port is busy, that's because something else is connected - notify and quit
-			if errors.Is(err, os.ErrPermission) {
-				d.logger.Warnw("Serial port seems busy, notifying user and closing",
-					"comPort", d.config.ConnectionInfo.COMPort)
+	if err := d.configUI.StartProfiling(); err != nil {
+		d.logger.Warnw("Failed to start profiling endpoint", "error", err)
+	}
 
-				d.notifier.Notify(fmt.Sprintf("Can't connect to %s!", d.config.ConnectionInfo.COMPort),
-					"This serial port is busy, make sure to close any serial monitor or other deej instance.")
+	// connect to the arduino(s) for the first time
+	go func() {
+		err := d.serial.Start()
+		if err == nil {
+			return
+		}
 
-				d.signalStop()
+		d.logger.Warnw("Failed to start first-time serial connection", "error", err)
 
-				// also notify if the COM port they gave isn't found, maybe their config is wrong
-			} else if errors.Is(err, os.ErrNotExist) {
-				d.logger.Warnw("Provided COM port seems wrong, notifying user and closing",
-					"comPort", d.config.ConnectionInfo.COMPort)
+		var startErrs *controllerStartErrors
+		if !errors.As(err, &startErrs) {
+			return
+		}
 
-				d.notifier.Notify(fmt.Sprintf("Can't connect to %s!", d.config.ConnectionInfo.COMPort),
-					"This serial port doesn't exist, check your configuration and make sure it's set correctly.")
+		// tell the user about every controller that can't connect, but keep running as long as one did
+		notified := false
+		for _, startErr := range startErrs.failed {
+			notified = d.notifyControllerStartError(startErr) || notified
+		}
 
-				d.signalStop()
-			}
+		if notified && startErrs.noneStarted() {
+			d.logger.Warn("No controller could connect, closing")
+			d.signalStop()
 		}
 	}()
 
@@ -184,6 +187,33 @@ func (d *Deej) run() {
 	}
 }
 
+// notifyControllerStartError notifies the user when a controller's port is busy or doesn't exist,
+// and returns whether it did. other failures are only logged
+func (d *Deej) notifyControllerStartError(startErr *controllerStartError) bool {
+
+	// If the port is busy, that's because something else is connected
+	if errors.Is(startErr, os.ErrPermission) {
+		d.logger.Warnw("Serial port seems busy, notifying user", "comPort", startErr.port)
+
+		d.notifier.Notify(fmt.Sprintf("Can't connect to %s!", startErr.port),
+			"This serial port is busy, make sure to close any serial monitor or other deej instance.")
+
+		return true
+	}
+
+	// also notify if the COM port they gave isn't found, maybe their config is wrong
+	if errors.Is(startErr, os.ErrNotExist) {
+		d.logger.Warnw("Provided COM port seems wrong, notifying user", "comPort", startErr.port)
+
+		d.notifier.Notify(fmt.Sprintf("Can't connect to %s!", startErr.port),
+			"This serial port doesn't exist, check your configuration and make sure it's set correctly.")
+
+		return true
+	}
+
+	return false
+}
+
 func (d *Deej) signalStop() {
 	d.logger.Debug("Signalling stop channel")
 	d.stopChannel <- true
@@ -194,7 +224,9 @@ func (d *Deej) stop() error {
 
 	d.config.StopWatchingConfigFile()
 	d.serial.Stop()
+	d.serial.Release()
 	d.configUI.Stop()
+	d.shellWorkers.stop()
 
 	// release the session map
 	if err := d.sessions.release(); err != nil {
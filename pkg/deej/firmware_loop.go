@@ -0,0 +1,590 @@
+package deej
+
+import (
+	"fmt"
+	"io"
+	"math"
+	"os"
+	"os/exec"
+	"sort"
+	"sync/atomic"
+	"time"
+
+	"go.uber.org/zap"
+)
+
+const (
+
+	// knob turns timed for latency, one at a time
+	firmwareLoopLatencyTurns = 200
+
+	// quiet time before each timed turn. the controller holds back-to-back reports for up to 10ms, and a turn
+	// after a pause is what shows how fast a knob gets through
+	firmwareLoopLatencyPause = 20 * time.Millisecond
+
+	// how long knobs are turned as fast as the controller takes it, for throughput
+	firmwareLoopThroughputDuration = 2 * time.Second
+	firmwareLoopThroughputStep     = 5 * time.Millisecond
+
+	// every turn moves a knob this far, clear of the default noise reduction's threshold. under load, knobs
+	// sweep up and down this many turns, which keeps them away from the end stops
+	firmwareLoopTurnDetents = 3
+	firmwareLoopSweepTurns  = 5
+
+	// the firmware's volume change per detent (ENCODER_VOLUME_PER_COUNT)
+	firmwareLoopVolumePerDetent = 0.02
+
+	// how long to wait for a knob turn or button press to reach deej before calling it lost
+	firmwareLoopEventTimeout = time.Second
+
+	// one keepalive report, and then some
+	firmwareLoopSettleTime = 400 * time.Millisecond
+
+	// how long the controller goes silent when rebooted, enough for the link monitor to call it stalled
+	firmwareLoopRebootSilence = linkStallTimeout + 2*linkPingInterval
+
+	// the controller's knobs move in 1% steps
+	firmwareLoopPositionTolerance = 0.011
+)
+
+// FirmwareLoopReport summarizes a firmware-in-the-loop run
+type FirmwareLoopReport struct {
+	Sliders int
+
+	// knob turns, from writing the turn to the firmware until the session map finished handling the move
+	LatencyTurns int
+	LatencyP50   time.Duration
+	LatencyP95   time.Duration
+	LatencyP99   time.Duration
+	LatencyMax   time.Duration
+
+	// lines and slider moves received while knobs were turned as fast as the controller takes it
+	Lines               uint64
+	MoveEvents          uint64
+	LinesPerSecond      float64
+	MoveEventsPerSecond float64
+
+	// slider moves the controller sent back after deej pushed volume changes to it
+	EchoEvents int
+
+	// everything that didn't behave, an empty list means the whole pipeline works
+	Failures []string
+}
+
+func (r FirmwareLoopReport) String() string {
+	result := "ok"
+	if len(r.Failures) > 0 {
+		result = fmt.Sprintf("%d failed checks", len(r.Failures))
+	}
+
+	return fmt.Sprintf("%s: %d sliders, %d knob turns (latency p50 %s, p95 %s, p99 %s, max %s), "+
+		"%d lines (%.0f lines/s) and %d move events (%.0f/s) under load, %d echo events",
+		result, r.Sliders, r.LatencyTurns, r.LatencyP50, r.LatencyP95, r.LatencyP99, r.LatencyMax,
+		r.Lines, r.LinesPerSecond, r.MoveEvents, r.MoveEventsPerSecond, r.EchoEvents)
+}
+
+// firmwareLoop connects a real SerialIO to the firmware, built as a Linux program (see arduino/host), over a pty
+type firmwareLoop struct {
+	logger *zap.SugaredLogger
+	deej   *Deej
+	device *SerialIO
+
+	firmware *exec.Cmd
+	input    io.WriteCloser
+
+	handled chan handledSliderMove
+	report  *FirmwareLoopReport
+}
+
+type handledSliderMove struct {
+	event SliderMoveEvent
+	at    time.Time
+}
+
+// RunFirmwareLoop runs the firmware executable at firmwarePath against deej's serial handling and fake audio
+// sessions. it checks the startup sync, knob turns, button presses and echo suppression end to end, and measures
+// latency and throughput along the way. failed checks are listed in the report, errors mean the run couldn't happen
+func RunFirmwareLoop(logger *zap.SugaredLogger, firmwarePath string) (FirmwareLoopReport, error) {
+	logger = logger.Named("firmware_loop")
+	report := FirmwareLoopReport{}
+
+	d, _, err := newReplayDeej(logger, 1)
+	if err != nil {
+		return report, fmt.Errorf("set up firmware loop: %w", err)
+	}
+	defer d.sessions.release()
+
+	// known targets, and deej in charge of what the controller shows
+	snapshot := *d.config.Snapshot()
+	snapshot.SliderMapping = replayDefaultSliderMapping()
+	snapshot.SendOnStartup = true
+	snapshot.SyncVolumes = false
+	snapshot.InvertSliders = false
+	d.config.publish(&snapshot)
+	d.sessions.rebuildMappedKeys()
+
+	fl := &firmwareLoop{
+		logger:  logger,
+		deej:    d,
+		device:  d.serial.currentDevices()[0],
+		handled: make(chan handledSliderMove, 1024),
+		report:  &report,
+	}
+
+	// handle slider moves here rather than in the session map's own goroutine, so we know when each one is done
+	sliderEvents := d.serial.SubscribeToSliderMoveEvents()
+	go func() {
+		for event := range sliderEvents {
+			d.sessions.handleSliderMoveEvent(event)
+			fl.handled <- handledSliderMove{event: event, at: time.Now()}
+		}
+	}()
+
+	if err := fl.start(firmwarePath); err != nil {
+		return report, err
+	}
+	defer fl.stop()
+
+	fl.checkStartupSync()
+	fl.measureLatency()
+	fl.measureThroughput()
+	fl.checkEchoSuppression()
+	fl.checkButtons()
+	fl.checkEncoderMute()
+	fl.checkRebootResync()
+
+	logger.Infow("Firmware loop finished", "report", report.String(), "failures", report.Failures)
+
+	return report, nil
+}
+
+// start launches the firmware on one side of a pty, and connects the controller's SerialIO to the other
+func (fl *firmwareLoop) start(firmwarePath string) error {
+	master, slave, err := openPTY()
+	if err != nil {
+		return fmt.Errorf("open pty: %w", err)
+	}
+
+	// the volumes the startup sync should show on the controller
+	for sliderIdx := 0; sliderIdx < replayDefaultSliders; sliderIdx++ {
+		fl.setSliderVolume(sliderIdx, 0.2+0.1*float32(sliderIdx%6))
+	}
+
+	fl.firmware = exec.Command(firmwarePath, "3")
+	fl.firmware.ExtraFiles = []*os.File{master}
+	fl.firmware.Stderr = os.Stderr
+
+	if fl.input, err = fl.firmware.StdinPipe(); err != nil {
+		master.Close()
+		slave.Close()
+		return fmt.Errorf("create firmware input pipe: %w", err)
+	}
+
+	if err := fl.firmware.Start(); err != nil {
+		master.Close()
+		slave.Close()
+		return fmt.Errorf("start firmware: %w", err)
+	}
+
+	// the firmware has its own copy, it sees the pty close once deej's side goes away
+	master.Close()
+
+	fl.logger.Infow("Started firmware", "path", firmwarePath, "pid", fl.firmware.Process.Pid)
+
+	fl.device.conn = nil
+	fl.device.setConnected(false)
+	fl.device.startWithConnection(slave)
+
+	return nil
+}
+
+func (fl *firmwareLoop) stop() {
+	fl.input.Close()
+
+	exited := make(chan error, 1)
+	go func() { exited <- fl.firmware.Wait() }()
+
+	select {
+	case <-exited:
+	case <-time.After(time.Second):
+		fl.firmware.Process.Kill()
+		<-exited
+	}
+
+	fl.device.Stop()
+}
+
+// checkStartupSync waits for the sync that runs on connect, then checks the controller shows deej's state,
+// and that the positions it reported back didn't change any volumes
+func (fl *firmwareLoop) checkStartupSync() {
+	fl.device.suppressSliderEventsUntilMu.Lock()
+	suppressUntil := fl.device.suppressSliderEventsUntil
+	fl.device.suppressSliderEventsUntilMu.Unlock()
+
+	time.Sleep(time.Until(suppressUntil) + firmwareLoopSettleTime)
+
+	reported, ok := fl.requestState()
+	if !ok {
+		fl.fail("controller didn't report its state after the startup sync")
+		return
+	}
+
+	fl.report.Sliders = len(reported.positions)
+
+	if expected := fl.device.expectedColorsHash(len(reported.positions)); reported.colors != expected {
+		fl.fail("controller shows colors hashing to %08x after the startup sync, expected %08x", reported.colors, expected)
+	}
+
+	if expected, configured := fl.device.expectedBackgroundHash(); configured && reported.background != expected {
+		fl.fail("controller shows a background hashing to %08x after the startup sync, expected %08x", reported.background, expected)
+	}
+
+	fl.checkPositions("startup sync", reported)
+
+	if moves := fl.drainHandled(); len(moves) > 0 {
+		fl.fail("controller's report of the synced positions moved %d sliders", len(moves))
+	}
+}
+
+// measureLatency turns the first knob back and forth, one turn at a time, and times each turn's way into the
+// session map. every turn has to arrive with the volume it turned to
+func (fl *firmwareLoop) measureLatency() {
+	volume, _ := fl.deej.sessions.sliderVolume(0)
+	latencies := make([]time.Duration, 0, firmwareLoopLatencyTurns)
+
+	for turn := 0; turn < firmwareLoopLatencyTurns; turn++ {
+		detents := firmwareLoopTurnDetents
+		if volume > 0.5 {
+			detents = -detents
+		}
+
+		expected := volume + float32(detents)*firmwareLoopVolumePerDetent
+
+		time.Sleep(firmwareLoopLatencyPause)
+		sent := time.Now()
+
+		if err := fl.send("turn e1 %d", detents); err != nil {
+			fl.fail("write knob turn: %v", err)
+			return
+		}
+
+		move, ok := fl.waitForMove(0)
+		if !ok {
+			fl.fail("knob turn %d never reached deej", turn)
+			return
+		}
+
+		if math.Abs(float64(move.event.PercentValue-expected)) > firmwareLoopPositionTolerance {
+			fl.fail("knob turn %d arrived as %.2f, expected %.2f", turn, move.event.PercentValue, expected)
+		}
+
+		latencies = append(latencies, move.at.Sub(sent))
+		volume = move.event.PercentValue
+	}
+
+	if current, _ := fl.deej.sessions.sliderVolume(0); math.Abs(float64(current-volume)) > firmwareLoopPositionTolerance {
+		fl.fail("slider 0's sessions are at %.2f after turning its knob, expected %.2f", current, volume)
+	}
+
+	sort.Slice(latencies, func(i, j int) bool { return latencies[i] < latencies[j] })
+
+	fl.report.LatencyTurns = len(latencies)
+	fl.report.LatencyP50 = latencyPercentile(latencies, 50)
+	fl.report.LatencyP95 = latencyPercentile(latencies, 95)
+	fl.report.LatencyP99 = latencyPercentile(latencies, 99)
+	fl.report.LatencyMax = latencies[len(latencies)-1]
+}
+
+// measureThroughput sweeps every knob up and down without waiting for anything, then checks that the
+// sessions ended up where the controller's knobs did
+func (fl *firmwareLoop) measureThroughput() {
+	linesBefore := atomic.LoadUint64(&fl.device.stats.linesRead)
+	moves := uint64(0)
+	start := time.Now()
+
+	ticker := time.NewTicker(firmwareLoopThroughputStep)
+	defer ticker.Stop()
+
+	for step := 0; time.Since(start) < firmwareLoopThroughputDuration; step++ {
+		detents := firmwareLoopTurnDetents
+		if (step/firmwareLoopSweepTurns)%2 == 1 {
+			detents = -detents
+		}
+
+		for encoder := 1; encoder <= fl.report.Sliders; encoder++ {
+			if err := fl.send("turn e%d %d", encoder, detents); err != nil {
+				fl.fail("write knob turn: %v", err)
+				return
+			}
+		}
+
+		<-ticker.C
+		moves += uint64(len(fl.drainHandled()))
+	}
+
+	duration := time.Since(start)
+
+	time.Sleep(firmwareLoopSettleTime)
+	moves += uint64(len(fl.drainHandled()))
+
+	fl.report.Lines = atomic.LoadUint64(&fl.device.stats.linesRead) - linesBefore
+	fl.report.MoveEvents = moves
+	fl.report.LinesPerSecond = float64(fl.report.Lines) / duration.Seconds()
+	fl.report.MoveEventsPerSecond = float64(moves) / duration.Seconds()
+
+	if reported, ok := fl.requestState(); ok {
+		fl.checkPositions("turning every knob", reported)
+	} else {
+		fl.fail("controller didn't report its state after turning every knob")
+	}
+}
+
+// checkEchoSuppression changes volumes on the system's side and pushes them to the controller, like volume
+// sync does. the controller reporting those positions back must leave the new volumes alone
+func (fl *firmwareLoop) checkEchoSuppression() {
+	// the sweep's last moves can still be on their way, and one landing after the sync would look like an echo
+	for attempt := 0; attempt < 5 && len(fl.drainHandled()) > 0; attempt++ {
+		time.Sleep(firmwareLoopSettleTime)
+	}
+
+	for sliderIdx := 0; sliderIdx < fl.report.Sliders; sliderIdx++ {
+		fl.setSliderVolume(sliderIdx, 0.8-0.1*float32(sliderIdx))
+	}
+
+	fl.deej.sessions.syncAllSliderVolumes()
+	time.Sleep(firmwareLoopSettleTime)
+
+	fl.report.EchoEvents = len(fl.drainHandled())
+
+	reported, ok := fl.requestState()
+	if !ok {
+		fl.fail("controller didn't report its state after volume sync")
+		return
+	}
+
+	for sliderIdx := 0; sliderIdx < fl.report.Sliders; sliderIdx++ {
+		expected := 0.8 - 0.1*float32(sliderIdx)
+		if current, _ := fl.deej.sessions.sliderVolume(sliderIdx); math.Abs(float64(current-expected)) > firmwareLoopPositionTolerance {
+			fl.fail("slider %d's sessions moved to %.2f after volume sync, expected them to stay at %.2f", sliderIdx, current, expected)
+		}
+	}
+
+	fl.checkPositions("volume sync", reported)
+}
+
+// checkButtons selects an output in each button group, and checks both the commands deej got and the
+// selections the controller shows
+func (fl *firmwareLoop) checkButtons() {
+	commandsBefore := atomic.LoadUint64(&fl.device.stats.commands)
+
+	// the firmware starts out with the first output of each group selected, and only reports changes
+	for _, source := range []string{"b2", "b1", "b4", "b3"} {
+		if err := fl.send("press %s", source); err != nil {
+			fl.fail("write button press: %v", err)
+			return
+		}
+
+		// past the firmware's debounce, without making it a long press
+		time.Sleep(100 * time.Millisecond)
+
+		if err := fl.send("release %s", source); err != nil {
+			fl.fail("write button release: %v", err)
+			return
+		}
+
+		time.Sleep(100 * time.Millisecond)
+	}
+
+	if commands := atomic.LoadUint64(&fl.device.stats.commands) - commandsBefore; commands < 4 {
+		fl.fail("4 button presses reached deej as %d commands", commands)
+	}
+
+	reported, ok := fl.requestState()
+	if !ok {
+		fl.fail("controller didn't report its state after button presses")
+		return
+	}
+
+	if len(reported.outputs) != 2 || reported.outputs[0] != 1 || reported.outputs[1] != 3 {
+		fl.fail("controller shows outputs %v after button presses, expected [1 3]", reported.outputs)
+	}
+}
+
+// checkEncoderMute taps one encoder's push switch and double presses another's. the tap mutes once the double
+// press window has passed, and the double press mustn't touch mute at all, not even briefly
+func (fl *firmwareLoop) checkEncoderMute() {
+	fl.drainHandled()
+
+	for _, source := range []string{"e1", "e2", "e2"} {
+		if err := fl.tap(source); err != nil {
+			fl.fail("write encoder press: %v", err)
+			return
+		}
+	}
+
+	// past the firmware's double press window
+	time.Sleep(500 * time.Millisecond)
+
+	// muting reports the knob at zero, so a double press that muted and unmuted shows up as moves
+	doublePressedSlider := fl.device.controller.SliderOffset + 1
+	for _, move := range fl.drainHandled() {
+		if move.event.SliderID == doublePressedSlider {
+			fl.fail("double press on e2 moved its slider to %.2f", move.event.PercentValue)
+		}
+	}
+
+	reported, ok := fl.requestState()
+	if !ok {
+		fl.fail("controller didn't report its state after encoder presses")
+		return
+	}
+
+	if len(reported.muted) < 2 || !reported.muted[0] || reported.muted[1] {
+		fl.fail("controller shows muted %v after a tap on e1 and a double press on e2, expected e1 muted only",
+			reported.muted)
+	}
+
+	// unmute again, so the controller ends up the way it started
+	if err := fl.tap("e1"); err != nil {
+		fl.fail("write encoder press: %v", err)
+	}
+	time.Sleep(500 * time.Millisecond)
+}
+
+// checkRebootResync reboots the controller, which comes back after a stall with every knob at zero. the link
+// monitor resyncs it, and none of those zeros may reach the sessions on the way
+func (fl *firmwareLoop) checkRebootResync() {
+	fl.drainHandled()
+
+	volumes := make([]float32, fl.report.Sliders)
+	for sliderIdx := range volumes {
+		volumes[sliderIdx], _ = fl.deej.sessions.sliderVolume(sliderIdx)
+	}
+
+	resyncsBefore := fl.device.link.snapshot().Resyncs
+
+	if err := fl.send("reboot %d", firmwareLoopRebootSilence.Milliseconds()); err != nil {
+		fl.fail("write reboot: %v", err)
+		return
+	}
+
+	time.Sleep(firmwareLoopRebootSilence + startupSliderSuppress + stateReplyTimeout + firmwareLoopSettleTime)
+
+	if fl.device.link.snapshot().Resyncs == resyncsBefore {
+		fl.fail("controller came back from a reboot without a resync")
+	}
+
+	for _, move := range fl.drainHandled() {
+		fl.fail("slider %d moved to %.2f while resyncing after a reboot", move.event.SliderID, move.event.PercentValue)
+	}
+
+	for sliderIdx, volume := range volumes {
+		if current, _ := fl.deej.sessions.sliderVolume(sliderIdx); math.Abs(float64(current-volume)) > firmwareLoopPositionTolerance {
+			fl.fail("slider %d's sessions moved from %.2f to %.2f over a reboot", sliderIdx, volume, current)
+		}
+	}
+
+	reported, ok := fl.requestState()
+	if !ok {
+		fl.fail("controller didn't report its state after rebooting")
+		return
+	}
+
+	fl.checkPositions("rebooting", reported)
+}
+
+// tap presses and releases a button or push switch, held past the firmware's debounce and released quickly enough
+// for two taps in a row to make a double press
+func (fl *firmwareLoop) tap(source string) error {
+	if err := fl.send("press %s", source); err != nil {
+		return err
+	}
+	time.Sleep(80 * time.Millisecond)
+
+	if err := fl.send("release %s", source); err != nil {
+		return err
+	}
+	time.Sleep(80 * time.Millisecond)
+
+	return nil
+}
+
+// checkPositions compares the positions the controller reported with the volumes of each slider's sessions
+func (fl *firmwareLoop) checkPositions(after string, reported controllerState) {
+	for localIdx, position := range reported.positions {
+		if reported.muted[localIdx] {
+			continue
+		}
+
+		volume, ok := fl.deej.sessions.sliderVolume(fl.device.controller.SliderOffset + localIdx)
+		if !ok {
+			continue
+		}
+
+		if math.Abs(float64(position-volume)) > firmwareLoopPositionTolerance {
+			fl.fail("slider %d shows %.2f after %s, its sessions are at %.2f", localIdx, position, after, volume)
+		}
+	}
+}
+
+// requestState asks the controller for its state, without racing a link resync for the reply
+func (fl *firmwareLoop) requestState() (controllerState, bool) {
+	fl.device.syncMu.Lock()
+	defer fl.device.syncMu.Unlock()
+
+	return fl.device.requestState()
+}
+
+// waitForMove waits for the session map to handle a move of the given slider, skipping any others
+func (fl *firmwareLoop) waitForMove(sliderIdx int) (handledSliderMove, bool) {
+	timeout := time.After(firmwareLoopEventTimeout)
+
+	for {
+		select {
+		case move := <-fl.handled:
+			if move.event.SliderID == sliderIdx {
+				return move, true
+			}
+		case <-timeout:
+			return handledSliderMove{}, false
+		}
+	}
+}
+
+// drainHandled takes every slider move handled so far
+func (fl *firmwareLoop) drainHandled() []handledSliderMove {
+	moves := []handledSliderMove{}
+
+	for {
+		select {
+		case move := <-fl.handled:
+			moves = append(moves, move)
+		default:
+			return moves
+		}
+	}
+}
+
+// setSliderVolume sets the volume of every session a slider controls, as if changed on the system's side
+func (fl *firmwareLoop) setSliderVolume(sliderIdx int, volume float32) {
+	targets, _ := fl.deej.config.Snapshot().SliderMapping.get(sliderIdx)
+
+	for _, target := range targets {
+		sessions, _ := fl.deej.sessions.get(target)
+		for _, session := range sessions {
+			session.SetVolume(volume)
+		}
+	}
+}
+
+func (fl *firmwareLoop) send(format string, args ...interface{}) error {
+	_, err := fmt.Fprintf(fl.input, format+"\n", args...)
+	return err
+}
+
+func (fl *firmwareLoop) fail(format string, args ...interface{}) {
+	failure := fmt.Sprintf(format, args...)
+
+	fl.logger.Warnw("Firmware loop check failed", "failure", failure)
+	fl.report.Failures = append(fl.report.Failures, failure)
+}
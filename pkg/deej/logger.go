@@ -52,7 +52,7 @@ func NewLogger(buildType string) (*zap.SugaredLogger, error) {
 		enc.AppendString(fmt.Sprintf("%-27s", s))
 	}
 
-	logger, err := loggerConfig.Build()
+	logger, err := buildAsyncLogger(loggerConfig)
 	if err != nil {
 		return nil, fmt.Errorf("create zap logger: %w", err)
 	}
@@ -62,3 +62,33 @@ func NewLogger(buildType string) (*zap.SugaredLogger, error) {
 
 	return sugar, nil
 }
+
+// buildAsyncLogger builds the logger the way loggerConfig.Build would, except that entries are written through
+// an asyncLogSink and repeated messages are sampled. verbose logging on hot paths (every serial line, every
+// slider move) then never waits for the disk or terminal, and can't flood either of them
+func buildAsyncLogger(loggerConfig zap.Config) (*zap.Logger, error) {
+	out, _, err := zap.Open(loggerConfig.OutputPaths...)
+	if err != nil {
+		return nil, fmt.Errorf("open log outputs: %w", err)
+	}
+
+	errorOut, _, err := zap.Open(loggerConfig.ErrorOutputPaths...)
+	if err != nil {
+		return nil, fmt.Errorf("open error outputs: %w", err)
+	}
+
+	drops := &logDropStats{}
+	encoder := zapcore.NewConsoleEncoder(loggerConfig.EncoderConfig)
+	sink := newAsyncLogSink(out, encoder.Clone(), drops)
+
+	core := newLogSampler(zapcore.NewCore(encoder, sink, loggerConfig.Level), drops)
+
+	options := []zap.Option{zap.ErrorOutput(errorOut)}
+	if loggerConfig.Development {
+		options = append(options, zap.Development(), zap.AddStacktrace(zapcore.WarnLevel))
+	} else {
+		options = append(options, zap.AddStacktrace(zapcore.ErrorLevel))
+	}
+
+	return zap.New(core, options...), nil
+}
@@ -0,0 +1,238 @@
+package deej
+
+import (
+	"sync"
+	"sync/atomic"
+	"time"
+
+	"go.uber.org/zap"
+	"go.uber.org/zap/zapcore"
+)
+
+const (
+
+	// how many encoded entries can wait for the log writer before new ones are dropped
+	asyncLogQueueSize = 1024
+
+	// the writer batches whatever is queued into a single write, up to this many bytes
+	asyncLogBatchBytes = 64 * 1024
+
+	// dropped and sampled out entries are reported at most this often
+	asyncLogReportInterval = 10 * time.Second
+
+	// identical messages (same level and text) are all logged up to this many times per sampling
+	// tick, and only every logSampleThereafter-th one after that. errors are never sampled
+	logSampleTick       = time.Second
+	logSampleFirst      = 20
+	logSampleThereafter = 100
+
+	// sampling counters, messages are spread across these by hash
+	logSampleCounters = 4096
+)
+
+// logDropStats counts entries that never made it to the log
+type logDropStats struct {
+	queueFull  uint64
+	sampledOut uint64
+}
+
+// asyncLogSink takes encoded log entries off the caller's goroutine. writes only copy the entry into a bounded
+// queue, and a single writer goroutine batches queued entries into the underlying output. when the queue is
+// full entries are dropped rather than blocking the caller, and the drops are reported in the log later on
+type asyncLogSink struct {
+	out     zapcore.WriteSyncer
+	entries chan []byte
+	flushes chan chan error
+	buffers sync.Pool
+
+	drops *logDropStats
+
+	// logs drop reports straight to out. only used by the writer goroutine
+	reporter *zap.SugaredLogger
+}
+
+func newAsyncLogSink(out zapcore.WriteSyncer, encoder zapcore.Encoder, drops *logDropStats) *asyncLogSink {
+	sink := &asyncLogSink{
+		out:     out,
+		entries: make(chan []byte, asyncLogQueueSize),
+		flushes: make(chan chan error),
+		drops:   drops,
+	}
+
+	sink.buffers.New = func() interface{} {
+		return make([]byte, 0, 256)
+	}
+
+	sink.reporter = zap.New(zapcore.NewCore(encoder, out, zapcore.WarnLevel)).Sugar().Named("logger")
+
+	go sink.run()
+
+	return sink
+}
+
+// Write queues a copy of an encoded entry, zap reuses the original once this returns
+func (s *asyncLogSink) Write(p []byte) (int, error) {
+	entry := append(s.buffers.Get().([]byte)[:0], p...)
+
+	select {
+	case s.entries <- entry:
+	default:
+		atomic.AddUint64(&s.drops.queueFull, 1)
+		s.buffers.Put(entry[:0])
+	}
+
+	return len(p), nil
+}
+
+// Sync blocks until everything queued before it has been written, then syncs the underlying output
+func (s *asyncLogSink) Sync() error {
+	done := make(chan error, 1)
+	s.flushes <- done
+
+	return <-done
+}
+
+func (s *asyncLogSink) run() {
+	batch := make([]byte, 0, asyncLogBatchBytes)
+
+	reportTicker := time.NewTicker(asyncLogReportInterval)
+	defer reportTicker.Stop()
+
+	var reported logDropStats
+
+	for {
+		select {
+		case entry := <-s.entries:
+
+			// take whatever else is already waiting too, so a burst costs a single write
+			batch = s.drain(s.appendEntry(batch[:0], entry))
+			s.out.Write(batch)
+
+		case done := <-s.flushes:
+			for len(s.entries) > 0 {
+				batch = s.drain(batch[:0])
+				s.out.Write(batch)
+			}
+
+			s.report(&reported)
+			done <- s.out.Sync()
+
+		case <-reportTicker.C:
+			s.report(&reported)
+		}
+	}
+}
+
+// drain appends queued entries to the batch, without waiting for more
+func (s *asyncLogSink) drain(batch []byte) []byte {
+	for len(batch) < asyncLogBatchBytes {
+		select {
+		case entry := <-s.entries:
+			batch = s.appendEntry(batch, entry)
+		default:
+			return batch
+		}
+	}
+
+	return batch
+}
+
+func (s *asyncLogSink) appendEntry(batch []byte, entry []byte) []byte {
+	batch = append(batch, entry...)
+	s.buffers.Put(entry[:0])
+
+	return batch
+}
+
+// report logs how many entries were dropped or sampled out since the last report, if any
+func (s *asyncLogSink) report(reported *logDropStats) {
+	queueFull := atomic.LoadUint64(&s.drops.queueFull)
+	sampledOut := atomic.LoadUint64(&s.drops.sampledOut)
+
+	if queueFull == reported.queueFull && sampledOut == reported.sampledOut {
+		return
+	}
+
+	s.reporter.Warnw("Some log entries were not written",
+		"queueFull", queueFull-reported.queueFull,
+		"sampledOut", sampledOut-reported.sampledOut,
+		"totalQueueFull", queueFull,
+		"totalSampledOut", sampledOut)
+
+	reported.queueFull = queueFull
+	reported.sampledOut = sampledOut
+}
+
+// logSampler rate-limits repeated messages, such as verbose logs for every serial line or a failing sync
+// retried on every tick. unlike zap's own sampler, it counts what it leaves out
+type logSampler struct {
+	zapcore.Core
+	counters *[logSampleCounters]logSampleCounter
+	drops    *logDropStats
+}
+
+type logSampleCounter struct {
+	resetAt int64
+	count   uint64
+}
+
+func newLogSampler(core zapcore.Core, drops *logDropStats) zapcore.Core {
+	return &logSampler{
+		Core:     core,
+		counters: &[logSampleCounters]logSampleCounter{},
+		drops:    drops,
+	}
+}
+
+func (s *logSampler) With(fields []zapcore.Field) zapcore.Core {
+	return &logSampler{
+		Core:     s.Core.With(fields),
+		counters: s.counters,
+		drops:    s.drops,
+	}
+}
+
+func (s *logSampler) Check(entry zapcore.Entry, checked *zapcore.CheckedEntry) *zapcore.CheckedEntry {
+	if !s.Enabled(entry.Level) {
+		return checked
+	}
+
+	if entry.Level < zapcore.ErrorLevel && !s.counter(entry).keep(entry.Time.UnixNano()) {
+		atomic.AddUint64(&s.drops.sampledOut, 1)
+		return checked
+	}
+
+	return s.Core.Check(entry, checked)
+}
+
+// counter picks a message's counter by its FNV-1a hash, computed inline so sampling doesn't allocate
+func (s *logSampler) counter(entry zapcore.Entry) *logSampleCounter {
+	const (
+		fnvOffset = 2166136261
+		fnvPrime  = 16777619
+	)
+
+	hash := uint32(fnvOffset)
+	hash = (hash ^ uint32(uint8(entry.Level))) * fnvPrime
+	for idx := 0; idx < len(entry.Message); idx++ {
+		hash = (hash ^ uint32(entry.Message[idx])) * fnvPrime
+	}
+
+	return &s.counters[hash%logSampleCounters]
+}
+
+// keep counts a message in the current tick, and says whether it should be logged
+func (c *logSampleCounter) keep(now int64) bool {
+	resetAt := atomic.LoadInt64(&c.resetAt)
+
+	if now > resetAt {
+		if atomic.CompareAndSwapInt64(&c.resetAt, resetAt, now+int64(logSampleTick)) {
+			atomic.StoreUint64(&c.count, 1)
+			return true
+		}
+	}
+
+	count := atomic.AddUint64(&c.count, 1)
+
+	return count <= logSampleFirst || (count-logSampleFirst)%logSampleThereafter == 0
+}
@@ -0,0 +1,132 @@
+package deej
+
+import (
+	"fmt"
+	"sync"
+	"time"
+
+	"go.uber.org/zap"
+)
+
+// outputActionQueues runs the commands for output selections, at most one at a time per button group.
+// like the controller, which only keeps one output per group active, only the latest selection matters:
+// presses that arrive while a group's command runs replace each other, and only the last one runs next
+type outputActionQueues struct {
+	deej   *Deej
+	logger *zap.SugaredLogger
+
+	mu     sync.Mutex
+	queues map[string]*outputActionQueue
+}
+
+// outputActionQueue is one button group's running command and the selection waiting for it to finish, if any
+type outputActionQueue struct {
+	name string
+
+	running bool
+	pending *outputSelection
+
+	runs       uint64
+	superseded uint64
+}
+
+// outputSelection is an output button press, with the command configured for it
+type outputSelection struct {
+	index    int
+	spec     CommandSpec
+	queuedAt time.Time
+}
+
+func newOutputActionQueues(d *Deej, logger *zap.SugaredLogger) *outputActionQueues {
+	return &outputActionQueues{
+		deej:   d,
+		logger: logger.Named("output-actions"),
+		queues: make(map[string]*outputActionQueue),
+	}
+}
+
+// submit runs a selection's command right away if its group is idle, or queues it (replacing whatever was
+// queued before it) until the group's running command finishes. a negative group means the controller didn't
+// say, in which case each output gets its own queue
+func (q *outputActionQueues) submit(group int, index int, spec CommandSpec) {
+	name := fmt.Sprintf("group%d", group)
+	if group < 0 {
+		name = fmt.Sprintf("output%d", index)
+	}
+
+	selection := &outputSelection{index: index, spec: spec, queuedAt: time.Now()}
+
+	q.mu.Lock()
+
+	queue, ok := q.queues[name]
+	if !ok {
+		queue = &outputActionQueue{name: name}
+		q.queues[name] = queue
+	}
+
+	if queue.running {
+		replaced := queue.pending
+		if replaced != nil {
+			queue.superseded++
+		}
+
+		queue.pending = selection
+		q.mu.Unlock()
+
+		if replaced != nil {
+			q.logger.Infow("Skipping superseded output selection", "queue", name, "skipped", replaced.index, "latest", index)
+		} else if q.deej.Verbose() {
+			q.logger.Debugw("Queued output selection behind running command", "queue", name, "index", index)
+		}
+
+		return
+	}
+
+	queue.running = true
+	q.mu.Unlock()
+
+	go q.run(queue, selection)
+}
+
+// run executes selections for a queue until nothing is pending anymore
+func (q *outputActionQueues) run(queue *outputActionQueue, selection *outputSelection) {
+	for selection != nil {
+		waited := time.Since(selection.queuedAt)
+		start := time.Now()
+
+		q.deej.executeCommandSpec(q.deej.logger.Named("commands").With("index", selection.index), selection.spec)
+
+		q.mu.Lock()
+
+		queue.runs++
+		runs, superseded := queue.runs, queue.superseded
+
+		next := queue.pending
+		queue.pending = nil
+		if next == nil {
+			queue.running = false
+		}
+
+		q.mu.Unlock()
+
+		if q.deej.Verbose() {
+
+			// depth counts the selection waiting behind this one, which runs next
+			depth := 0
+			if next != nil {
+				depth = 1
+			}
+
+			q.logger.Debugw("Ran output selection",
+				"queue", queue.name,
+				"index", selection.index,
+				"waited", waited,
+				"took", time.Since(start),
+				"depth", depth,
+				"runs", runs,
+				"superseded", superseded)
+		}
+
+		selection = next
+	}
+}
@@ -64,5 +64,8 @@ func (d *Deej) recoverFromPanic() {
 	// bye :(
 	d.signalStop()
 	d.logger.Errorw("Quitting", "exitCode", 1)
+
+	// log entries are written asynchronously, make sure they get out before we do
+	d.logger.Sync()
 	os.Exit(1)
 }
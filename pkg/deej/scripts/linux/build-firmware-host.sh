@@ -0,0 +1,11 @@
+#!/bin/sh
+
+echo 'Building the controller firmware for Linux (firmware-in-the-loop harness)...'
+
+g++ -std=c++17 -O2 -Wall -I arduino/host -o deej-firmware-host arduino/host/firmware_host.cpp
+if [ $? -eq 0 ]; then
+    echo 'Done.'
+else
+    echo 'Error: "g++" exited with a non-zero code. Are you running this script from the root deej directory?'
+    exit 1
+fi
@@ -1,15 +1,15 @@
 package deej
 
 import (
-	"bufio"
+	"bytes"
 	"errors"
 	"fmt"
 	"io"
-	"regexp"
 	"sort"
 	"strconv"
 	"strings"
 	"sync"
+	"sync/atomic"
 	"time"
 
 	"github.com/jacobsa/go-serial/serial"
@@ -18,23 +18,39 @@ import (
 	"github.com/omriharel/deej/pkg/deej/util"
 )
 
-// SerialIO provides a deej-aware abstraction layer to managing serial I/O
+// SerialIO provides a deej-aware abstraction layer to managing serial I/O with a single controller.
+// its sliders occupy a window of deej's slider indices, starting at the controller's slider offset
 type SerialIO struct {
-	comPort  string
-	baudRate uint
+	controller ControllerConfig
 
-	deej   *Deej
-	logger *zap.SugaredLogger
+	// this controller's position in the controller set, used to tag its captured traffic
+	index int
+
+	// how many slider indices this controller owns, starting at its offset (0 means no upper bound)
+	sliderLimit int
+
+	deej        *Deej
+	logger      *zap.SugaredLogger
+	controllers *serialControllers
 
 	stopChannel chan bool
-	connected   bool
 	connOptions serial.OpenOptions
-	conn        io.ReadWriteCloser
 
-	lastKnownNumSliders        int
+	// written to from several goroutines (link monitor, syncs, display updates), and closed from yet another.
+	// connMu serializes writes, and keeps the connection from closing under one
+	conn   io.ReadWriteCloser
+	connMu sync.Mutex
+
+	// connected and the slider count are also read by the config UI and the link monitor, so they're only
+	// accessed atomically (see isConnected and numSliders)
+	connected           int32
+	lastKnownNumSliders int32
+
 	currentSliderPercentValues []float32
 
-	sliderMoveConsumers []chan SliderMoveEvent
+	// a line's raw slider values and move events, reused for every line
+	lineValues     []int
+	lineMoveEvents []SliderMoveEvent
 
 	lastSentSliderPositions   map[int]float32
 	lastSentSliderPositionsMu sync.Mutex
@@ -43,35 +59,75 @@ type SerialIO struct {
 	// echo/feedback loops when we send initial display values to the controller
 	suppressSliderEventsUntil   time.Time
 	suppressSliderEventsUntilMu sync.Mutex
+
+	stats *serialStats
+	link  *serialLinkMonitor
+
+	// replies to state dump requests, handed from the read loop to a state sync
+	stateReplies chan controllerState
+	syncMu       sync.Mutex
+}
+
+// serialStats holds running counters about the serial link. these are updated atomically from
+// the read loop and sampled by the config UI, so they're kept in their own (64-bit aligned) allocation
+type serialStats struct {
+	linesRead      uint64
+	malformedLines uint64
+	moveEvents     uint64
+	commands       uint64
+	lastLineAt     int64
+}
+
+// serialStatsSnapshot is a point-in-time copy of the serial link's health
+type serialStatsSnapshot struct {
+	Connected      bool   `json:"connected"`
+	Port           string `json:"port"`
+	SliderOffset   int    `json:"sliderOffset"`
+	Sliders        int    `json:"sliders"`
+	LinesRead      uint64 `json:"linesRead"`
+	MalformedLines uint64 `json:"malformedLines"`
+	MoveEvents     uint64 `json:"moveEvents"`
+	Commands       uint64 `json:"commands"`
+	LastLineAt     int64  `json:"lastLineAt"`
+
+	Link serialLinkSnapshot `json:"link"`
 }
 
+// how long incoming slider events are ignored after pushing slider positions to a controller
+const startupSliderSuppress = 700 * time.Millisecond
+
 // SliderMoveEvent represents a single slider move captured by deej
 type SliderMoveEvent struct {
 	SliderID     int
 	PercentValue float32
 }
 
-var expectedLinePattern = regexp.MustCompile(`^\d{1,4}(\|\d{1,4})*$`)
+// how much a single read takes from the connection. lines are short, so this fits any backlog
+const serialReadChunkSize = 4096
+
+var errSerialNotConnected = errors.New("serial: connection not established")
 
-// NewSerialIO creates a SerialIO instance that uses the provided deej
-// instance's connection info to establish communications with the arduino chip
-func NewSerialIO(deej *Deej, logger *zap.SugaredLogger) (*SerialIO, error) {
+// NewSerialIO creates a SerialIO instance that uses the provided controller's
+// connection info to establish communications with the arduino chip
+func NewSerialIO(deej *Deej, logger *zap.SugaredLogger, controllers *serialControllers, controller ControllerConfig, sliderLimit int) (*SerialIO, error) {
 	logger = logger.Named("serial")
 
 	sio := &SerialIO{
+		controller:              controller,
+		sliderLimit:             sliderLimit,
 		deej:                    deej,
 		logger:                  logger,
+		controllers:             controllers,
 		stopChannel:             make(chan bool),
-		connected:               false,
 		conn:                    nil,
-		sliderMoveConsumers:     []chan SliderMoveEvent{},
 		lastSentSliderPositions: make(map[int]float32),
+		stats:                   &serialStats{},
+		stateReplies:            make(chan controllerState, 1),
 	}
 
-	logger.Debug("Created serial i/o instance")
+	sio.link = newSerialLinkMonitor(sio)
 
-	// respond to config changes
-	sio.setupOnConfigReload()
+	logger.Debugw("Created serial i/o instance", "comPort", controller.COMPort, "sliderOffset", controller.SliderOffset)
 
 	return sio, nil
 }
@@ -80,7 +136,7 @@ func NewSerialIO(deej *Deej, logger *zap.SugaredLogger) (*SerialIO, error) {
 func (sio *SerialIO) Start() error {
 
 	// don't allow multiple concurrent connections
-	if sio.connected {
+	if sio.isConnected() {
 		sio.logger.Warn("Already connected, can't start another without closing first")
 		return errors.New("serial: connection already active")
 	}
@@ -94,8 +150,8 @@ func (sio *SerialIO) Start() error {
 	}
 
 	sio.connOptions = serial.OpenOptions{
-		PortName:        sio.deej.config.ConnectionInfo.COMPort,
-		BaudRate:        uint(sio.deej.config.ConnectionInfo.BaudRate),
+		PortName:        sio.controller.COMPort,
+		BaudRate:        uint(sio.controller.BaudRate),
 		DataBits:        8,
 		StopBits:        1,
 		MinimumReadSize: uint(minimumReadSize),
@@ -106,8 +162,7 @@ func (sio *SerialIO) Start() error {
 		"baudRate", sio.connOptions.BaudRate,
 		"minReadSize", minimumReadSize)
 
-	var err error
-	sio.conn, err = serial.Open(sio.connOptions)
+	conn, err := serial.Open(sio.connOptions)
 	if err != nil {
 
 		// might need a user notification here, TBD
@@ -115,41 +170,58 @@ func (sio *SerialIO) Start() error {
 		return fmt.Errorf("open serial connection: %w", err)
 	}
 
-	namedLogger := sio.logger.Named(strings.ToLower(sio.connOptions.PortName))
+	sio.startWithConnection(conn)
 
-	namedLogger.Infow("Connected", "conn", sio.conn)
-	sio.connected = true
-	sio.resetSliderDisplayCache()
+	return nil
+}
 
-	if err := sio.sendLightingConfiguration(namedLogger); err != nil {
-		namedLogger.Warnw("Failed to send lighting configuration", "error", err)
+// startWithConnection runs an opened connection: syncs the controller, starts the link monitor
+// and reads lines until stopped
+func (sio *SerialIO) startWithConnection(conn io.ReadWriteCloser) {
+	sio.connMu.Lock()
+	sio.conn = conn
+	sio.connMu.Unlock()
+
+	if err := tuneSerialPortLatency(conn); err != nil {
+		sio.logger.Debugw("Couldn't tune serial port for low latency", "error", err)
 	}
 
-	if err := sio.sendInitialSliderVolumes(namedLogger); err != nil {
-		namedLogger.Warnw("Failed to send initial slider volumes", "error", err)
+	namedLogger := sio.logger.Named(strings.ToLower(sio.controller.COMPort))
+
+	namedLogger.Infow("Connected", "conn", conn)
+	sio.setConnected(true)
+	sio.resetSliderDisplayCache()
+
+	// the startup sync needs the controller's replies, so it runs alongside the read loop. until it's done,
+	// slider events are held back - the controller may still show positions from before we connected
+	if sio.deej.config.Snapshot().SendOnStartup {
+		sio.suppressSliderEvents(startupSliderSuppress + stateReplyTimeout)
 	}
 
-	// read lines or await a stop
+	sio.link.start()
+	go sio.syncOnConnect(namedLogger)
+
+	// read lines, and close the connection once stopped. lines are handled by the reading goroutine itself,
+	// and the connection never closes while one is being handled
+	var readMu sync.Mutex
+	done := make(chan struct{})
+
+	go sio.readLines(namedLogger, conn, &readMu, done)
+
 	go func() {
-		connReader := bufio.NewReader(sio.conn)
-		lineChannel := sio.readLine(namedLogger, connReader)
+		<-sio.stopChannel
 
-		for {
-			select {
-			case <-sio.stopChannel:
-				sio.close(namedLogger)
-			case line := <-lineChannel:
-				sio.handleLine(namedLogger, line)
-			}
-		}
-	}()
+		readMu.Lock()
+		defer readMu.Unlock()
 
-	return nil
+		close(done)
+		sio.close(namedLogger)
+	}()
 }
 
 // Stop signals us to shut down our serial connection, if one is active
 func (sio *SerialIO) Stop() {
-	if sio.connected {
+	if sio.isConnected() {
 		sio.logger.Debug("Shutting down serial connection")
 		sio.stopChannel <- true
 	} else {
@@ -157,135 +229,202 @@ func (sio *SerialIO) Stop() {
 	}
 }
 
-// SubscribeToSliderMoveEvents returns an unbuffered channel that receives
-// a sliderMoveEvent struct every time a slider moves
-func (sio *SerialIO) SubscribeToSliderMoveEvents() chan SliderMoveEvent {
-	ch := make(chan SliderMoveEvent)
-	sio.sliderMoveConsumers = append(sio.sliderMoveConsumers, ch)
+// Stats returns a snapshot of the serial link's counters
+func (sio *SerialIO) Stats() serialStatsSnapshot {
+	return serialStatsSnapshot{
+		Connected:      sio.isConnected(),
+		Port:           sio.controller.COMPort,
+		SliderOffset:   sio.controller.SliderOffset,
+		Sliders:        sio.numSliders(),
+		LinesRead:      atomic.LoadUint64(&sio.stats.linesRead),
+		MalformedLines: atomic.LoadUint64(&sio.stats.malformedLines),
+		MoveEvents:     atomic.LoadUint64(&sio.stats.moveEvents),
+		Commands:       atomic.LoadUint64(&sio.stats.commands),
+		LastLineAt:     atomic.LoadInt64(&sio.stats.lastLineAt) / int64(time.Millisecond),
+		Link:           sio.link.snapshot(),
+	}
+}
 
-	return ch
+func (sio *SerialIO) isConnected() bool {
+	return atomic.LoadInt32(&sio.connected) != 0
 }
 
-func (sio *SerialIO) setupOnConfigReload() {
-	configReloadedChannel := sio.deej.config.SubscribeToChanges()
+func (sio *SerialIO) setConnected(connected bool) {
+	value := int32(0)
+	if connected {
+		value = 1
+	}
+
+	atomic.StoreInt32(&sio.connected, value)
+}
+
+// numSliders is how many sliders the controller's last line had, or 0 until the next line arrives
+func (sio *SerialIO) numSliders() int {
+	return int(atomic.LoadInt32(&sio.lastKnownNumSliders))
+}
+
+// forgetNumSliders makes the next line look like a new slider count, which re-sends every slider's position
+func (sio *SerialIO) forgetNumSliders() {
+	atomic.StoreInt32(&sio.lastKnownNumSliders, 0)
+}
 
-	const stopDelay = 50 * time.Millisecond
+// onConfigReload is called by the controller set when the config changes without affecting this controller's connection
+func (sio *SerialIO) onConfigReload() {
+	const reloadDelay = 50 * time.Millisecond
 
+	// make any config reload unset our slider number to ensure process volumes are being re-set
+	// (the next read line will emit SliderMoveEvent instances for all sliders)
+	// this needs to happen after a small delay, because the session map will also re-acquire sessions
+	// whenever the config file is reloaded, and we don't want it to receive these move events while the map
+	// is still cleared. this is kind of ugly, but shouldn't cause any issues
 	go func() {
-		for {
-			select {
-			case <-configReloadedChannel:
-
-				// make any config reload unset our slider number to ensure process volumes are being re-set
-				// (the next read line will emit SliderMoveEvent instances for all sliders)\
-				// this needs to happen after a small delay, because the session map will also re-acquire sessions
-				// whenever the config file is reloaded, and we don't want it to receive these move events while the map
-				// is still cleared. this is kind of ugly, but shouldn't cause any issues
-				go func() {
-					<-time.After(stopDelay)
-					sio.lastKnownNumSliders = 0
-				}()
-
-				// if connection params have changed, attempt to stop and start the connection
-				if sio.deej.config.ConnectionInfo.COMPort != sio.connOptions.PortName ||
-					uint(sio.deej.config.ConnectionInfo.BaudRate) != sio.connOptions.BaudRate {
-
-					sio.logger.Info("Detected change in connection parameters, attempting to renew connection")
-					sio.Stop()
-
-					// let the connection close
-					<-time.After(stopDelay)
-
-					if err := sio.Start(); err != nil {
-						sio.logger.Warnw("Failed to renew connection after parameter change", "error", err)
-					} else {
-						sio.logger.Debug("Renewed connection successfully")
-					}
-				} else if sio.connected {
-					go func() {
-						<-time.After(stopDelay)
-						if !sio.connected {
-							return
-						}
-
-						if err := sio.sendLightingConfiguration(sio.logger); err != nil {
-							sio.logger.Warnw("Failed to send lighting configuration after reload", "error", err)
-						}
-					}()
-				}
-			}
+		<-time.After(reloadDelay)
+		sio.forgetNumSliders()
+
+		if !sio.isConnected() {
+			return
 		}
+
+		sio.syncState(sio.logger, false)
 	}()
 }
 
+// ownsSlider maps one of deej's slider indices to this controller's own slider index, if it falls in its window
+func (sio *SerialIO) ownsSlider(sliderIdx int) (int, bool) {
+	localIdx := sliderIdx - sio.controller.SliderOffset
+	if localIdx < 0 || (sio.sliderLimit > 0 && localIdx >= sio.sliderLimit) {
+		return 0, false
+	}
+
+	return localIdx, true
+}
+
 func (sio *SerialIO) close(logger *zap.SugaredLogger) {
-	if err := sio.conn.Close(); err != nil {
+	sio.link.halt()
+
+	// a ping or sync may still be on its way out, it finishes first and later ones find no connection
+	sio.connMu.Lock()
+	conn := sio.conn
+	sio.conn = nil
+	sio.connMu.Unlock()
+
+	if err := conn.Close(); err != nil {
 		logger.Warnw("Failed to close serial connection", "error", err)
 	} else {
 		logger.Debug("Serial connection closed")
 	}
 
-	sio.conn = nil
-	sio.connected = false
+	sio.setConnected(false)
 	sio.resetSliderDisplayCache()
 }
 
-func (sio *SerialIO) readLine(logger *zap.SugaredLogger, reader *bufio.Reader) chan string {
-	ch := make(chan string)
+// readLines reads the connection in chunks, into a buffer that's reused for every read, and handles each
+// complete line in place. it stops when a read fails (including because the connection was closed)
+func (sio *SerialIO) readLines(logger *zap.SugaredLogger, conn io.Reader, readMu *sync.Mutex, done chan struct{}) {
+	buf := make([]byte, serialReadChunkSize)
+	pending := 0
 
-	go func() {
-		for {
-			line, err := reader.ReadString('\n')
-			if err != nil {
+	for {
+		n, err := conn.Read(buf[pending:])
+		if err != nil {
+
+			if sio.deej.Verbose() {
+				logger.Warnw("Failed to read from serial", "error", err, "pending", string(buf[:pending]))
+			}
 
-				if sio.deej.Verbose() {
-					logger.Warnw("Failed to read line from serial", "error", err, "line", line)
-				}
+			// just ignore the partial line, the connection is done
+			return
+		}
+
+		readMu.Lock()
 
-				// just ignore the line, the read loop will stop after this
-				return
+		select {
+		case <-done:
+			readMu.Unlock()
+			return
+		default:
+		}
+
+		data := buf[:pending+n]
+		for {
+			newline := bytes.IndexByte(data, '\n')
+			if newline < 0 {
+				break
 			}
 
+			line := data[:newline+1]
+			data = data[newline+1:]
+
 			if sio.deej.Verbose() {
-				logger.Debugw("Read new line", "line", line)
+				logger.Debugw("Read new line", "line", string(line))
 			}
 
-			// deliver the line to the channel
-			ch <- line
+			sio.handleLineBytes(logger, line)
 		}
-	}()
 
-	return ch
+		readMu.Unlock()
+
+		// keep the partial line for the next read. one that fills the whole buffer is garbage, and dropped
+		pending = copy(buf, data)
+		if pending == len(buf) {
+			atomic.AddUint64(&sio.stats.malformedLines, 1)
+			pending = 0
+		}
+	}
 }
 
+// handleLine handles a line given as a string, see handleLineBytes
 func (sio *SerialIO) handleLine(logger *zap.SugaredLogger, line string) {
+	sio.handleLineBytes(logger, []byte(line))
+}
+
+// handleLineBytes handles one line from the controller. the line is only read during the call,
+// so it can point into the read buffer
+func (sio *SerialIO) handleLineBytes(logger *zap.SugaredLogger, line []byte) {
 
 	// this function receives an unsanitized line which is guaranteed to end with LF,
 	// but most lines will end with CRLF.
-	sanitized := strings.TrimRight(line, "\r\n")
+	sanitized := bytes.TrimRight(line, "\r\n")
 
-	if sanitized == "" {
+	if len(sanitized) == 0 {
 		return
 	}
 
-	if sio.tryHandleCommand(logger, sanitized) {
+	if recorder := sio.controllers.recorder; recorder != nil {
+		recorder.record(serialCaptureRX, sio.index, string(sanitized))
+	}
+
+	atomic.AddUint64(&sio.stats.linesRead, 1)
+	now := time.Now()
+	atomic.StoreInt64(&sio.stats.lastLineAt, now.UnixNano())
+	sio.link.onLine(now)
+
+	// only command lines ("X:...") become strings, slider lines are parsed in place
+	if len(sanitized) >= 3 && sanitized[1] == ':' && sio.tryHandleCommand(logger, string(sanitized)) {
+		atomic.AddUint64(&sio.stats.commands, 1)
 		return
 	}
 
 	// may have garbage instead of deej-formatted values, so we must check for that!
 	// just ignore bad ones
-	if !expectedLinePattern.MatchString(sanitized) {
+	values, ok := parseSliderValues(sanitized, sio.lineValues)
+	sio.lineValues = values
+	if !ok {
+		atomic.AddUint64(&sio.stats.malformedLines, 1)
 		return
 	}
 
-	// split on pipe (|), this gives a slice of numerical strings between "0" and "1023"
-	splitLine := strings.Split(sanitized, "|")
-	numSliders := len(splitLine)
+	// sliders past this controller's window belong to the next controller's indices, so they're ignored
+	if sio.sliderLimit > 0 && len(values) > sio.sliderLimit {
+		values = values[:sio.sliderLimit]
+	}
+
+	numSliders := len(values)
 
 	// update our slider count, if needed - this will send slider move events for all
-	if numSliders != sio.lastKnownNumSliders {
-		logger.Infow("Detected sliders", "amount", numSliders)
-		sio.lastKnownNumSliders = numSliders
+	if numSliders != sio.numSliders() {
+		logger.Infow("Detected sliders", "amount", numSliders, "sliderOffset", sio.controller.SliderOffset)
+		atomic.StoreInt32(&sio.lastKnownNumSliders, int32(numSliders))
 		sio.currentSliderPercentValues = make([]float32, numSliders)
 
 		// reset everything to be an impossible value to force the slider move event later
@@ -294,16 +433,17 @@ func (sio *SerialIO) handleLine(logger *zap.SugaredLogger, line string) {
 		}
 	}
 
-	// for each slider:
-	moveEvents := []SliderMoveEvent{}
-	for sliderIdx, stringValue := range splitLine {
+	// one config snapshot for the whole line
+	config := sio.deej.config.Snapshot()
 
-		// convert string values to integers ("1023" -> 1023)
-		number, _ := strconv.Atoi(stringValue)
+	// for each slider:
+	moveEvents := sio.lineMoveEvents[:0]
+	for sliderIdx, number := range values {
 
 		// turns out serial lines can occasionally come out dirty; reject any out-of-range value
-		if number < 0 || number > 1023 {
-			sio.logger.Debugw("Got malformed line from serial, ignoring", "line", sanitized)
+		if number > 1023 {
+			sio.logger.Debugw("Got malformed line from serial, ignoring", "line", string(sanitized))
+			atomic.AddUint64(&sio.stats.malformedLines, 1)
 			return
 		}
 
@@ -314,18 +454,18 @@ func (sio *SerialIO) handleLine(logger *zap.SugaredLogger, line string) {
 		normalizedScalar := util.NormalizeScalar(dirtyFloat)
 
 		// if sliders are inverted, take the complement of 1.0
-		if sio.deej.config.InvertSliders {
+		if config.InvertSliders {
 			normalizedScalar = 1 - normalizedScalar
 		}
 
 		// check if it changes the desired state (could just be a jumpy raw slider value)
-		if util.SignificantlyDifferent(sio.currentSliderPercentValues[sliderIdx], normalizedScalar, sio.deej.config.NoiseReductionLevel) {
+		if util.SignificantlyDifferent(sio.currentSliderPercentValues[sliderIdx], normalizedScalar, config.NoiseReductionLevel) {
 
 			// if it does, update the saved value and create a move event
 			sio.currentSliderPercentValues[sliderIdx] = normalizedScalar
 
 			moveEvents = append(moveEvents, SliderMoveEvent{
-				SliderID:     sliderIdx,
+				SliderID:     sio.controller.SliderOffset + sliderIdx,
 				PercentValue: normalizedScalar,
 			})
 
@@ -335,8 +475,23 @@ func (sio *SerialIO) handleLine(logger *zap.SugaredLogger, line string) {
 		}
 	}
 
+	sio.lineMoveEvents = moveEvents
+
 	// deliver move events if there are any, towards all potential consumers
 	if len(moveEvents) > 0 {
+		atomic.AddUint64(&sio.stats.moveEvents, uint64(len(moveEvents)))
+
+		// the controller now shows these knobs where they were turned, not where we last put them, so the next
+		// display update for them has to go out even if it's the same value as before
+		sio.lastSentSliderPositionsMu.Lock()
+		for _, event := range moveEvents {
+			delete(sio.lastSentSliderPositions, event.SliderID-sio.controller.SliderOffset)
+		}
+		sio.lastSentSliderPositionsMu.Unlock()
+
+		// the config UI shows knob positions as-is, even while we're suppressing their effect
+		sio.controllers.onSliderValues(sio.controller.SliderOffset, sio.currentSliderPercentValues)
+
 		// check if we're currently suppressing incoming slider events (e.g. during startup sync)
 		sio.suppressSliderEventsUntilMu.Lock()
 		suppressUntil := sio.suppressSliderEventsUntil
@@ -349,12 +504,38 @@ func (sio *SerialIO) handleLine(logger *zap.SugaredLogger, line string) {
 			return
 		}
 
-		for _, consumer := range sio.sliderMoveConsumers {
-			for _, moveEvent := range moveEvents {
-				consumer <- moveEvent
+		sio.controllers.deliverSliderMoveEvents(moveEvents)
+	}
+}
+
+// parseSliderValues parses a slider line ("<value>|<value>|...", each value 1 to 4 digits) into values,
+// reusing its storage. it returns false for anything else
+func parseSliderValues(line []byte, values []int) ([]int, bool) {
+	values = values[:0]
+	value, digits := 0, 0
+
+	for _, c := range line {
+		switch {
+		case c >= '0' && c <= '9':
+			if digits == 4 {
+				return values, false
 			}
+
+			value = value*10 + int(c-'0')
+			digits++
+		case c == '|' && digits > 0:
+			values = append(values, value)
+			value, digits = 0, 0
+		default:
+			return values, false
 		}
 	}
+
+	if digits == 0 {
+		return values, false
+	}
+
+	return append(values, value), true
 }
 
 func (sio *SerialIO) tryHandleCommand(logger *zap.SugaredLogger, line string) bool {
@@ -362,7 +543,34 @@ func (sio *SerialIO) tryHandleCommand(logger *zap.SugaredLogger, line string) bo
 		return false
 	}
 
-	if (line[0] != 'O' && line[0] != 'o') || line[1] != ':' {
+	if line[1] != ':' {
+		return false
+	}
+
+	// pong, answering one of our link health pings
+	if line[0] == 'Q' || line[0] == 'q' {
+		sio.link.onPong(logger, strings.TrimSpace(line[2:]))
+		return true
+	}
+
+	// state dump, answering a state sync's request
+	if line[0] == 'S' || line[0] == 's' {
+		sio.onStateDump(logger, strings.TrimSpace(line[2:]))
+		return true
+	}
+
+	// gesture the controller recognized
+	if line[0] == 'G' || line[0] == 'g' {
+		sio.onGesture(logger, strings.TrimSpace(line[2:]))
+		return true
+	}
+
+	// diagnostics someone asked the controller for (stage timings, trace dumps), nothing for deej to do
+	if line[0] == 'T' || line[0] == 'D' {
+		return true
+	}
+
+	if line[0] != 'O' && line[0] != 'o' {
 		return false
 	}
 
@@ -374,7 +582,10 @@ func (sio *SerialIO) tryHandleCommand(logger *zap.SugaredLogger, line string) bo
 		return true
 	}
 
-	index, err := strconv.Atoi(payload)
+	// "O:<index>[:<group>]", older firmware doesn't report the button group
+	fields := strings.SplitN(payload, ":", 2)
+
+	index, err := strconv.Atoi(fields[0])
 	if err != nil {
 		if sio.deej.Verbose() {
 			logger.Debugw("Ignoring command with non-numeric index", "payload", payload)
@@ -382,50 +593,89 @@ func (sio *SerialIO) tryHandleCommand(logger *zap.SugaredLogger, line string) bo
 		return true
 	}
 
-	sio.deej.RunConfiguredCommand(index)
+	group := -1
+	if len(fields) == 2 {
+		if group, err = strconv.Atoi(fields[1]); err != nil || group < 0 {
+			if sio.deej.Verbose() {
+				logger.Debugw("Ignoring invalid button group, queueing by output instead", "payload", payload)
+			}
+			group = -1
+		}
+	}
+
+	sio.deej.RunConfiguredCommand(index, group)
 
 	return true
 }
 
 func (sio *SerialIO) sendLightingConfiguration(logger *zap.SugaredLogger) error {
-	if !sio.deej.config.SendOnStartup {
+	if !sio.deej.config.Snapshot().SendOnStartup {
 		return nil
 	}
 
-	if sio.conn == nil || !sio.connected {
-		return errors.New("serial: connection not established")
+	if !sio.isConnected() {
+		return errSerialNotConnected
 	}
 
-	background := strings.TrimSpace(sio.deej.config.BackgroundLighting)
-	if background != "" {
-		if err := sio.writeSerialLine(fmt.Sprintf("B:%s", background)); err != nil {
-			return fmt.Errorf("send background lighting: %w", err)
-		}
+	if err := sio.sendBackgroundLighting(logger); err != nil {
+		return err
+	}
 
-		if sio.deej.Verbose() {
-			logger.Debugw("Sent background lighting", "value", background)
-		}
+	if err := sio.sendColorMapping(logger); err != nil {
+		return err
+	}
+
+	if len(sio.deej.config.Snapshot().Animations) == 0 {
+		return nil
+	}
+
+	return sio.sendAnimations(logger)
+}
+
+func (sio *SerialIO) sendBackgroundLighting(logger *zap.SugaredLogger) error {
+	background := strings.TrimSpace(sio.deej.config.Snapshot().BackgroundLighting)
+	if background == "" {
+		return nil
+	}
+
+	if err := sio.writeSerialLine(fmt.Sprintf("B:%s", background)); err != nil {
+		return fmt.Errorf("send background lighting: %w", err)
+	}
+
+	if sio.deej.Verbose() {
+		logger.Debugw("Sent background lighting", "value", background)
 	}
 
-	if len(sio.deej.config.ColorMapping) == 0 {
+	return nil
+}
+
+// sendColorMapping sends the configured colors of this controller's sliders
+func (sio *SerialIO) sendColorMapping(logger *zap.SugaredLogger) error {
+	colorMapping := sio.deej.config.Snapshot().ColorMapping
+	if len(colorMapping) == 0 {
 		return nil
 	}
 
-	indices := make([]int, 0, len(sio.deej.config.ColorMapping))
-	for idx := range sio.deej.config.ColorMapping {
+	indices := make([]int, 0, len(colorMapping))
+	for idx := range colorMapping {
 		indices = append(indices, idx)
 	}
 	sort.Ints(indices)
 
 	for _, idx := range indices {
-		entry := sio.deej.config.ColorMapping[idx]
+		localIdx, ok := sio.ownsSlider(idx)
+		if !ok {
+			continue
+		}
+
+		entry := colorMapping[idx]
 		zero := strings.TrimSpace(entry.Zero)
 		full := strings.TrimSpace(entry.Full)
 		if zero == "" || full == "" {
 			continue
 		}
 
-		if err := sio.writeSerialLine(fmt.Sprintf("C:%d:%s:%s", idx, zero, full)); err != nil {
+		if err := sio.writeSerialLine(fmt.Sprintf("C:%d:%s:%s", localIdx, zero, full)); err != nil {
 			return fmt.Errorf("send color mapping for slider %d: %w", idx, err)
 		}
 
@@ -438,15 +688,19 @@ func (sio *SerialIO) sendLightingConfiguration(logger *zap.SugaredLogger) error
 }
 
 // sendInitialSliderVolumes pushes the current session volumes to the controller for startup sync.
+// only the sliders in this controller's window are sent, so other controllers aren't disturbed
 func (sio *SerialIO) sendInitialSliderVolumes(logger *zap.SugaredLogger) error {
-	if !sio.deej.config.SendOnStartup {
+	config := sio.deej.config.Snapshot()
+	if !config.SendOnStartup {
 		return nil
 	}
 
 	indices := []int{}
 
-	sio.deej.config.SliderMapping.iterate(func(sliderIdx int, _ []string) {
-		indices = append(indices, sliderIdx)
+	config.SliderMapping.iterate(func(sliderIdx int, _ []string) {
+		if _, ok := sio.ownsSlider(sliderIdx); ok {
+			indices = append(indices, sliderIdx)
+		}
 	})
 
 	if len(indices) == 0 {
@@ -458,10 +712,7 @@ func (sio *SerialIO) sendInitialSliderVolumes(logger *zap.SugaredLogger) error {
 	// suppress incoming slider move events for a short window so the controller's
 	// initial echo doesn't cause deej to accidentally apply the same values to
 	// system/app volumes.
-	const startupSuppress = 700 * time.Millisecond
-	sio.suppressSliderEventsUntilMu.Lock()
-	sio.suppressSliderEventsUntil = time.Now().Add(startupSuppress)
-	sio.suppressSliderEventsUntilMu.Unlock()
+	sio.suppressSliderEvents(startupSliderSuppress)
 
 	for _, idx := range indices {
 		volume, ok := sio.deej.sessions.sliderVolume(idx)
@@ -471,7 +722,8 @@ func (sio *SerialIO) sendInitialSliderVolumes(logger *zap.SugaredLogger) error {
 			}
 			volume = 0
 		}
-		if err := sio.SendSliderDisplayValue(idx, volume); err != nil {
+		localIdx, _ := sio.ownsSlider(idx)
+		if err := sio.SendSliderDisplayValue(localIdx, volume); err != nil {
 			return fmt.Errorf("send initial volume for slider %d: %w", idx, err)
 		}
 	}
@@ -479,9 +731,18 @@ func (sio *SerialIO) sendInitialSliderVolumes(logger *zap.SugaredLogger) error {
 	return nil
 }
 
-// SendSliderDisplayValue sends a display update for a slider, caching the last transmitted value.
+// suppressSliderEvents holds back incoming slider move events for the given duration from now
+func (sio *SerialIO) suppressSliderEvents(duration time.Duration) {
+	sio.suppressSliderEventsUntilMu.Lock()
+	defer sio.suppressSliderEventsUntilMu.Unlock()
+
+	sio.suppressSliderEventsUntil = time.Now().Add(duration)
+}
+
+// SendSliderDisplayValue sends a display update for one of this controller's own sliders (not offset),
+// caching the last transmitted value.
 func (sio *SerialIO) SendSliderDisplayValue(sliderIdx int, percent float32) error {
-	if sio.conn == nil || !sio.connected {
+	if !sio.isConnected() {
 		return nil
 	}
 
@@ -492,7 +753,7 @@ func (sio *SerialIO) SendSliderDisplayValue(sliderIdx int, percent float32) erro
 	}
 
 	position := percent
-	if sio.deej.config.InvertSliders {
+	if sio.deej.config.Snapshot().InvertSliders {
 		position = 1 - position
 	}
 
@@ -530,10 +791,21 @@ func (sio *SerialIO) resetSliderDisplayCache() {
 }
 
 func (sio *SerialIO) writeSerialLine(payload string) error {
+	if recorder := sio.controllers.recorder; recorder != nil {
+		recorder.record(serialCaptureTX, sio.index, strings.TrimRight(payload, "\r\n"))
+	}
+
 	if !strings.HasSuffix(payload, "\r\n") {
 		payload += "\r\n"
 	}
 
+	sio.connMu.Lock()
+	defer sio.connMu.Unlock()
+
+	if sio.conn == nil {
+		return errSerialNotConnected
+	}
+
 	_, err := sio.conn.Write([]byte(payload))
 	return err
 }
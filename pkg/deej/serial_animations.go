@@ -0,0 +1,90 @@
+package deej
+
+import (
+	"encoding/binary"
+	"fmt"
+	"hash/fnv"
+
+	"go.uber.org/zap"
+)
+
+// animationPayloads returns the payloads that upload an animation to one of the controller's slots:
+// "<slot>:<leds>:<trigger>:<loop|once>" for the definition, then "<slot>:<at>:<color>" for each keyframe
+func animationPayloads(slot int, animation AnimationConfig) (string, []string) {
+	repeat := "once"
+	if animation.Loop {
+		repeat = "loop"
+	}
+
+	definition := fmt.Sprintf("%d:%s:%s:%s", slot, animation.LEDs, animation.Trigger, repeat)
+
+	keyframes := make([]string, len(animation.Keyframes))
+	for idx, keyframe := range animation.Keyframes {
+		keyframes[idx] = fmt.Sprintf("%d:%d:%s", slot, keyframe.At, keyframe.Color)
+	}
+
+	return definition, keyframes
+}
+
+// expectedAnimationHash hashes the animations the controller holds after receiving ours. each slot hashes
+// the payloads that defined it (each followed by a newline), and the result hashes every slot's hash
+// (0 for an empty slot) as little endian bytes
+func (sio *SerialIO) expectedAnimationHash() uint32 {
+	animations := sio.deej.config.Snapshot().Animations
+	hash := fnv.New32a()
+	slotHashBytes := make([]byte, 4)
+
+	for slot := 0; slot < maxAnimations; slot++ {
+		var slotHash uint32
+
+		if slot < len(animations) {
+			definition, keyframes := animationPayloads(slot, animations[slot])
+
+			payloadHash := fnv.New32a()
+			payloadHash.Write([]byte(definition + "\n"))
+			for _, keyframe := range keyframes {
+				payloadHash.Write([]byte(keyframe + "\n"))
+			}
+
+			slotHash = payloadHash.Sum32()
+		}
+
+		binary.LittleEndian.PutUint32(slotHashBytes, slotHash)
+		hash.Write(slotHashBytes)
+	}
+
+	return hash.Sum32()
+}
+
+// sendAnimations uploads every configured animation, and clears the controller's remaining slots
+func (sio *SerialIO) sendAnimations(logger *zap.SugaredLogger) error {
+	animations := sio.deej.config.Snapshot().Animations
+
+	for slot := 0; slot < maxAnimations; slot++ {
+		if slot >= len(animations) {
+			if err := sio.writeSerialLine(fmt.Sprintf("A:%d:clear", slot)); err != nil {
+				return fmt.Errorf("clear animation %d: %w", slot, err)
+			}
+
+			continue
+		}
+
+		definition, keyframes := animationPayloads(slot, animations[slot])
+
+		if err := sio.writeSerialLine("A:" + definition); err != nil {
+			return fmt.Errorf("send animation %d: %w", slot, err)
+		}
+
+		for _, keyframe := range keyframes {
+			if err := sio.writeSerialLine("K:" + keyframe); err != nil {
+				return fmt.Errorf("send animation %d keyframe: %w", slot, err)
+			}
+		}
+
+		if sio.deej.Verbose() {
+			logger.Debugw("Sent animation", "slot", slot, "definition", definition, "keyframes", len(keyframes))
+		}
+	}
+
+	return nil
+}
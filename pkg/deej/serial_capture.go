@@ -0,0 +1,260 @@
+package deej
+
+import (
+	"bufio"
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"io"
+	"os"
+	"sync"
+	"time"
+
+	"go.uber.org/zap"
+)
+
+// capture files hold timestamped serial traffic, recorded from a live controller and replayed by ReplaySerialCapture.
+// the format is a fixed header followed by variable-length records:
+//
+//	header: "DEEJCAP" | version (1 byte) | capture start, unix nanoseconds (8 bytes, little endian)
+//	record: nanoseconds since previous record (uvarint) | flags (1 byte) | payload length (uvarint) | payload
+//
+// the flags byte holds the direction in its lowest bit, and the controller's index in the remaining bits.
+// payloads are lines without their line endings
+const (
+
+	// when this is set to a file path, deej records all serial traffic to it
+	envSerialCapture = "DEEJ_SERIAL_CAPTURE"
+
+	serialCaptureMagic   = "DEEJCAP"
+	serialCaptureVersion = 1
+
+	// buffered records are written to disk at least this often
+	serialCaptureFlushInterval = time.Second
+
+	// longest payload accepted when reading a capture, anything longer means the file is corrupt
+	serialCaptureMaxPayload = 64 * 1024
+)
+
+// serialCaptureDirection tells whether a recorded line was read from or written to a controller
+type serialCaptureDirection byte
+
+const (
+	serialCaptureRX serialCaptureDirection = 0
+	serialCaptureTX serialCaptureDirection = 1
+)
+
+// serialCaptureRecord is a single line of recorded serial traffic
+type serialCaptureRecord struct {
+	Offset     time.Duration // since the start of the capture
+	Direction  serialCaptureDirection
+	Controller int
+	Payload    string
+}
+
+// serialRecorder appends serial traffic to a capture file. recording happens on the serial hot path,
+// so records go to a buffer that's flushed in the background
+type serialRecorder struct {
+	logger *zap.SugaredLogger
+
+	mu         sync.Mutex
+	file       *os.File
+	writer     *bufio.Writer
+	lastRecord time.Time
+	scratch    [2*binary.MaxVarintLen64 + 1]byte
+	closed     bool
+
+	stopFlushing chan struct{}
+}
+
+// serialRecorderFromEnv starts a recorder if one was requested through the environment, or returns nil
+func serialRecorderFromEnv(logger *zap.SugaredLogger) *serialRecorder {
+	path, ok := os.LookupEnv(envSerialCapture)
+	if !ok || path == "" {
+		return nil
+	}
+
+	recorder, err := newSerialRecorder(logger, path)
+	if err != nil {
+		logger.Warnw("Failed to start serial capture", "path", path, "error", err)
+		return nil
+	}
+
+	return recorder
+}
+
+func newSerialRecorder(logger *zap.SugaredLogger, path string) (*serialRecorder, error) {
+	file, err := os.Create(path)
+	if err != nil {
+		return nil, fmt.Errorf("create capture file: %w", err)
+	}
+
+	now := time.Now()
+
+	header := make([]byte, 0, len(serialCaptureMagic)+9)
+	header = append(header, serialCaptureMagic...)
+	header = append(header, serialCaptureVersion)
+	header = append(header, make([]byte, 8)...)
+	binary.LittleEndian.PutUint64(header[len(header)-8:], uint64(now.UnixNano()))
+
+	writer := bufio.NewWriter(file)
+	if _, err := writer.Write(header); err != nil {
+		file.Close()
+		return nil, fmt.Errorf("write capture header: %w", err)
+	}
+
+	r := &serialRecorder{
+		logger:       logger.Named("capture"),
+		file:         file,
+		writer:       writer,
+		lastRecord:   now,
+		stopFlushing: make(chan struct{}),
+	}
+
+	go r.flushPeriodically()
+
+	r.logger.Infow("Recording serial traffic", "path", path)
+
+	return r, nil
+}
+
+func (r *serialRecorder) record(direction serialCaptureDirection, controller int, payload string) {
+	r.mu.Lock()
+	defer r.mu.Unlock()
+
+	if r.closed {
+		return
+	}
+
+	now := time.Now()
+	delta := now.Sub(r.lastRecord)
+	if delta < 0 {
+		delta = 0
+	}
+	r.lastRecord = now
+
+	n := binary.PutUvarint(r.scratch[:], uint64(delta))
+	r.scratch[n] = byte(controller<<1) | byte(direction)
+	n++
+	n += binary.PutUvarint(r.scratch[n:], uint64(len(payload)))
+
+	r.writer.Write(r.scratch[:n])
+	if _, err := r.writer.WriteString(payload); err != nil {
+		r.logger.Warnw("Failed to write capture record, stopping capture", "error", err)
+		r.closeLocked()
+	}
+}
+
+func (r *serialRecorder) flushPeriodically() {
+	ticker := time.NewTicker(serialCaptureFlushInterval)
+	defer ticker.Stop()
+
+	for {
+		select {
+		case <-ticker.C:
+			r.mu.Lock()
+			if !r.closed {
+				if err := r.writer.Flush(); err != nil {
+					r.logger.Warnw("Failed to flush capture file, stopping capture", "error", err)
+					r.closeLocked()
+				}
+			}
+			r.mu.Unlock()
+		case <-r.stopFlushing:
+			return
+		}
+	}
+}
+
+func (r *serialRecorder) close() {
+	r.mu.Lock()
+	defer r.mu.Unlock()
+
+	r.closeLocked()
+}
+
+func (r *serialRecorder) closeLocked() {
+	if r.closed {
+		return
+	}
+
+	r.closed = true
+	close(r.stopFlushing)
+
+	if err := r.writer.Flush(); err != nil {
+		r.logger.Warnw("Failed to flush capture file", "error", err)
+	}
+
+	if err := r.file.Close(); err != nil {
+		r.logger.Warnw("Failed to close capture file", "error", err)
+	} else {
+		r.logger.Debugw("Closed capture file", "path", r.file.Name())
+	}
+}
+
+// readSerialCapture loads every record from a capture file
+func readSerialCapture(path string) ([]serialCaptureRecord, error) {
+	file, err := os.Open(path)
+	if err != nil {
+		return nil, fmt.Errorf("open capture file: %w", err)
+	}
+	defer file.Close()
+
+	reader := bufio.NewReader(file)
+
+	header := make([]byte, len(serialCaptureMagic)+9)
+	if _, err := io.ReadFull(reader, header); err != nil {
+		return nil, fmt.Errorf("read capture header: %w", err)
+	}
+
+	if string(header[:len(serialCaptureMagic)]) != serialCaptureMagic {
+		return nil, errors.New("not a deej capture file")
+	}
+
+	if version := header[len(serialCaptureMagic)]; version != serialCaptureVersion {
+		return nil, fmt.Errorf("unsupported capture version %d", version)
+	}
+
+	records := []serialCaptureRecord{}
+	offset := time.Duration(0)
+
+	for {
+		delta, err := binary.ReadUvarint(reader)
+		if err == io.EOF {
+			return records, nil
+		}
+
+		// a capture cut short (e.g. deej was killed mid-flush) still has every complete record before it
+		if err != nil {
+			return records, nil
+		}
+
+		flags, err := reader.ReadByte()
+		if err != nil {
+			return records, nil
+		}
+
+		length, err := binary.ReadUvarint(reader)
+		if err != nil {
+			return records, nil
+		}
+
+		if length > serialCaptureMaxPayload {
+			return records, fmt.Errorf("capture record %d has an invalid length (%d)", len(records), length)
+		}
+
+		payload := make([]byte, length)
+		if _, err := io.ReadFull(reader, payload); err != nil {
+			return records, nil
+		}
+
+		offset += time.Duration(delta)
+
+		records = append(records, serialCaptureRecord{
+			Offset:     offset,
+			Direction:  serialCaptureDirection(flags & 1),
+			Controller: int(flags >> 1),
+			Payload:    string(payload),
+		})
+	}
+}
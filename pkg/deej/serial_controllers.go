@@ -0,0 +1,266 @@
+package deej
+
+import (
+	"fmt"
+	"strings"
+	"sync"
+	"time"
+
+	"go.uber.org/zap"
+)
+
+// serialControllers manages every configured controller as one set. each controller has its own connection
+// and read loop, but their sliders share one index space (through per-controller offsets), one set of
+// slider move consumers and one display output path
+type serialControllers struct {
+	deej   *Deej
+	logger *zap.SugaredLogger
+
+	mu      sync.Mutex
+	devices []*SerialIO
+
+	sliderMoveConsumers []chan SliderMoveEvent
+
+	// records all serial traffic when enabled through the environment, otherwise nil
+	recorder *serialRecorder
+
+	// knob positions of all controllers, by deej's slider index (-1 where no controller reports a slider)
+	sliderValuesMu sync.Mutex
+	sliderValues   []float32
+}
+
+// controllerStartError identifies which controller failed to connect
+type controllerStartError struct {
+	port string
+	err  error
+}
+
+func (e *controllerStartError) Error() string {
+	return fmt.Sprintf("start controller on %s: %v", e.port, e.err)
+}
+
+func (e *controllerStartError) Unwrap() error {
+	return e.err
+}
+
+// controllerStartErrors lists every controller that failed to connect, out of all the ones that were attempted
+type controllerStartErrors struct {
+	failed    []*controllerStartError
+	attempted int
+}
+
+func (e *controllerStartErrors) Error() string {
+	ports := make([]string, len(e.failed))
+	for idx, failed := range e.failed {
+		ports[idx] = failed.Error()
+	}
+
+	return fmt.Sprintf("%d of %d controllers failed to start: %s", len(e.failed), e.attempted, strings.Join(ports, "; "))
+}
+
+// noneStarted tells whether every attempted controller failed to connect
+func (e *controllerStartErrors) noneStarted() bool {
+	return len(e.failed) == e.attempted
+}
+
+func newSerialControllers(deej *Deej, logger *zap.SugaredLogger) *serialControllers {
+	sc := &serialControllers{
+		deej:                deej,
+		logger:              logger.Named("controllers"),
+		sliderMoveConsumers: []chan SliderMoveEvent{},
+		recorder:            serialRecorderFromEnv(logger),
+	}
+
+	sc.logger.Debug("Created controller set")
+
+	// respond to config changes
+	sc.setupOnConfigReload()
+
+	return sc
+}
+
+// Start connects to every configured controller. a controller that fails to connect doesn't prevent
+// the others from starting - once all of them were attempted, failures are returned as *controllerStartErrors
+func (sc *serialControllers) Start() error {
+	devices, err := sc.buildDevices(sc.deej.config.Snapshot().Controllers)
+	if err != nil {
+		return err
+	}
+
+	sc.mu.Lock()
+	sc.devices = devices
+	sc.mu.Unlock()
+
+	startErrs := &controllerStartErrors{attempted: len(devices)}
+
+	for _, device := range devices {
+		if err := device.Start(); err != nil {
+			startErrs.failed = append(startErrs.failed, &controllerStartError{port: device.controller.COMPort, err: err})
+		}
+	}
+
+	if len(startErrs.failed) == 0 {
+		return nil
+	}
+
+	return startErrs
+}
+
+// Stop shuts down all active controller connections
+func (sc *serialControllers) Stop() {
+	for _, device := range sc.currentDevices() {
+		device.Stop()
+	}
+}
+
+// Release stops serial capture, if it's running. call after Stop
+func (sc *serialControllers) Release() {
+	if sc.recorder != nil {
+		sc.recorder.close()
+	}
+}
+
+// Stats returns a snapshot of every controller's link counters, ordered by slider offset
+func (sc *serialControllers) Stats() []serialStatsSnapshot {
+	devices := sc.currentDevices()
+
+	stats := make([]serialStatsSnapshot, len(devices))
+	for idx, device := range devices {
+		stats[idx] = device.Stats()
+	}
+
+	return stats
+}
+
+// SubscribeToSliderMoveEvents returns an unbuffered channel that receives
+// a sliderMoveEvent struct every time a slider moves, on any controller
+func (sc *serialControllers) SubscribeToSliderMoveEvents() chan SliderMoveEvent {
+	ch := make(chan SliderMoveEvent)
+	sc.sliderMoveConsumers = append(sc.sliderMoveConsumers, ch)
+
+	return ch
+}
+
+// SendSliderDisplayValue sends a display update for one of deej's sliders to the controller that owns it
+func (sc *serialControllers) SendSliderDisplayValue(sliderIdx int, percent float32) error {
+	for _, device := range sc.currentDevices() {
+		if localIdx, ok := device.ownsSlider(sliderIdx); ok {
+			return device.SendSliderDisplayValue(localIdx, percent)
+		}
+	}
+
+	return nil
+}
+
+func (sc *serialControllers) currentDevices() []*SerialIO {
+	sc.mu.Lock()
+	defer sc.mu.Unlock()
+
+	return sc.devices
+}
+
+// buildDevices creates a SerialIO for each controller. controllers are sorted by offset, and one without
+// an explicit slider count owns every index up to the next controller's offset
+func (sc *serialControllers) buildDevices(controllers []ControllerConfig) ([]*SerialIO, error) {
+	devices := make([]*SerialIO, 0, len(controllers))
+
+	for idx, controller := range controllers {
+		sliderLimit := controller.Sliders
+		if sliderLimit <= 0 && idx+1 < len(controllers) {
+			sliderLimit = controllers[idx+1].SliderOffset - controller.SliderOffset
+		}
+
+		device, err := NewSerialIO(sc.deej, sc.logger, sc, controller, sliderLimit)
+		if err != nil {
+			sc.logger.Errorw("Failed to create SerialIO", "comPort", controller.COMPort, "error", err)
+			return nil, fmt.Errorf("create new SerialIO for %s: %w", controller.COMPort, err)
+		}
+
+		device.index = idx
+		devices = append(devices, device)
+	}
+
+	return devices, nil
+}
+
+func (sc *serialControllers) setupOnConfigReload() {
+	configReloadedChannel := sc.deej.config.SubscribeToChanges()
+
+	const stopDelay = 50 * time.Millisecond
+
+	go func() {
+		for {
+			select {
+			case <-configReloadedChannel:
+				devices := sc.currentDevices()
+
+				// if the set of controllers or any of their connection params have changed, reconnect all of them
+				if !sc.devicesMatch(devices, sc.deej.config.Snapshot().Controllers) {
+					sc.logger.Info("Detected change in controllers, attempting to renew connections")
+					sc.Stop()
+
+					// let the connections close
+					<-time.After(stopDelay)
+
+					sc.resetSliderValues()
+
+					if err := sc.Start(); err != nil {
+						sc.logger.Warnw("Failed to renew connections after controller change", "error", err)
+					} else {
+						sc.logger.Debug("Renewed connections successfully")
+					}
+
+					continue
+				}
+
+				for _, device := range devices {
+					device.onConfigReload()
+				}
+			}
+		}
+	}()
+}
+
+func (sc *serialControllers) devicesMatch(devices []*SerialIO, controllers []ControllerConfig) bool {
+	if len(devices) != len(controllers) {
+		return false
+	}
+
+	for idx, device := range devices {
+		if device.controller != controllers[idx] {
+			return false
+		}
+	}
+
+	return true
+}
+
+// deliverSliderMoveEvents hands move events from any controller's read loop to all consumers
+func (sc *serialControllers) deliverSliderMoveEvents(moveEvents []SliderMoveEvent) {
+	for _, consumer := range sc.sliderMoveConsumers {
+		for _, moveEvent := range moveEvents {
+			consumer <- moveEvent
+		}
+	}
+}
+
+// onSliderValues merges one controller's knob positions into the shared slider index space for the config UI
+func (sc *serialControllers) onSliderValues(sliderOffset int, values []float32) {
+	sc.sliderValuesMu.Lock()
+	defer sc.sliderValuesMu.Unlock()
+
+	for len(sc.sliderValues) < sliderOffset+len(values) {
+		sc.sliderValues = append(sc.sliderValues, -1)
+	}
+
+	copy(sc.sliderValues[sliderOffset:], values)
+
+	sc.deej.configUI.onSliderValues(sc.sliderValues)
+}
+
+func (sc *serialControllers) resetSliderValues() {
+	sc.sliderValuesMu.Lock()
+	defer sc.sliderValuesMu.Unlock()
+
+	sc.sliderValues = nil
+}
@@ -0,0 +1,114 @@
+package deej
+
+import (
+	"errors"
+	"fmt"
+	"regexp"
+	"sort"
+	"strconv"
+	"strings"
+
+	"go.uber.org/zap"
+)
+
+const (
+
+	// gestures the firmware recognizes. a turn is named after its direction
+	gestureLong     = "long"
+	gestureDouble   = "double"
+	gestureChord    = "chord"
+	gestureTurnUp   = "turn_up"
+	gestureTurnDown = "turn_down"
+)
+
+// a gesture source: b1-b8 for dome buttons, e1-e8 for encoder push switches
+var gestureSourcePattern = regexp.MustCompile(`^([be])([1-8])$`)
+
+// normalizeGestureName checks a gesture name, "<kind> <source>" or "chord <source>+<source>[+...]",
+// and returns it lowercased with a chord's sources in the order the firmware reports them (buttons first)
+func normalizeGestureName(name string) (string, error) {
+	fields := strings.Fields(strings.ToLower(name))
+	if len(fields) != 2 {
+		return "", errors.New("expected \"<kind> <source>\"")
+	}
+
+	kind := fields[0]
+	sources := strings.Split(fields[1], "+")
+
+	switch kind {
+	case gestureLong, gestureDouble, gestureTurnUp, gestureTurnDown:
+		if len(sources) != 1 {
+			return "", fmt.Errorf("%s takes a single source", kind)
+		}
+	case gestureChord:
+		if len(sources) < 2 {
+			return "", errors.New("chord takes two or more sources")
+		}
+	default:
+		return "", fmt.Errorf("unknown gesture %q", kind)
+	}
+
+	seen := make(map[string]bool, len(sources))
+	for _, source := range sources {
+		if !gestureSourcePattern.MatchString(source) {
+			return "", fmt.Errorf("invalid source %q", source)
+		}
+
+		if seen[source] {
+			return "", fmt.Errorf("duplicate source %q", source)
+		}
+		seen[source] = true
+	}
+
+	if (kind == gestureTurnUp || kind == gestureTurnDown) && sources[0][0] != 'e' {
+		return "", fmt.Errorf("%s needs an encoder source", kind)
+	}
+
+	// "b" sorts before "e", and sources are single digits
+	sort.Strings(sources)
+
+	return kind + " " + strings.Join(sources, "+"), nil
+}
+
+// onGesture handles a "G:" line's payload, "<kind>:<sources>[:<detents>]", by running the gesture's command.
+// called from the read loop
+func (sio *SerialIO) onGesture(logger *zap.SugaredLogger, payload string) {
+	parts := strings.Split(payload, ":")
+	if len(parts) < 2 {
+		logger.Debugw("Ignoring malformed gesture", "payload", payload)
+		return
+	}
+
+	kind := parts[0]
+	detents := 0
+
+	if kind == "turn" {
+		if len(parts) != 3 {
+			logger.Debugw("Ignoring malformed gesture", "payload", payload)
+			return
+		}
+
+		var err error
+		if detents, err = strconv.Atoi(strings.TrimPrefix(parts[2], "+")); err != nil || detents == 0 {
+			logger.Debugw("Ignoring gesture with invalid detents", "payload", payload)
+			return
+		}
+
+		kind = gestureTurnUp
+		if detents < 0 {
+			kind = gestureTurnDown
+		}
+	}
+
+	name, err := normalizeGestureName(kind + " " + parts[1])
+	if err != nil {
+		logger.Debugw("Ignoring unknown gesture", "payload", payload, "error", err)
+		return
+	}
+
+	if sio.deej.Verbose() {
+		logger.Debugw("Got gesture", "gesture", name, "detents", detents)
+	}
+
+	sio.deej.RunGestureCommand(name)
+}
@@ -0,0 +1,320 @@
+package deej
+
+import (
+	"fmt"
+	"strconv"
+	"strings"
+	"sync"
+	"time"
+
+	"go.uber.org/zap"
+)
+
+const (
+
+	// how often the host pings a connected controller
+	linkPingInterval = time.Second
+
+	// a ping that isn't answered within this time counts as lost
+	linkPingTimeout = 2 * time.Second
+
+	// the firmware reports slider values at least every 250ms, so this much silence means it's wedged or the link is down
+	linkStallTimeout = 3 * time.Second
+
+	// this many pings lost in a row (after the controller answered at least once) triggers a resync
+	linkMaxConsecutiveLosses = 3
+
+	// link health is summarized in the logs this often
+	linkSummaryInterval = time.Minute
+)
+
+// serialLinkMonitor measures a controller link's round-trip time, jitter and loss through ping/pong commands,
+// and detects stalls (no lines at all). when the link degrades or recovers from a stall, the controller is resynced.
+//
+// the host sends "P:<seq>:<host micros>", and the firmware answers "Q:<seq>:<host micros>:<device millis>:<held micros>".
+// the firmware answers from its main loop rather than the serial driver's callback, so it reports how long the
+// ping was held there, and that time is taken out of the round-trip time (older firmware doesn't report it)
+type serialLinkMonitor struct {
+	sio    *SerialIO
+	logger *zap.SugaredLogger
+
+	mu sync.Mutex
+
+	epoch   time.Time
+	seq     uint32
+	pending map[uint32]time.Time
+
+	// smoothed round-trip time and its mean deviation (jitter), as in RFC 6298
+	srtt   time.Duration
+	rttvar time.Duration
+	rtt    time.Duration
+
+	pingsSent         uint64
+	pongsReceived     uint64
+	pingsLost         uint64
+	consecutiveLosses int
+	pongSeen          bool
+
+	lastLineAt   time.Time
+	stalled      bool
+	deviceMillis uint64
+	resyncs      uint64
+
+	stop chan struct{}
+}
+
+// serialLinkSnapshot is a point-in-time copy of a link's health
+type serialLinkSnapshot struct {
+	RTTMicros    int64  `json:"rttMicros"`
+	JitterMicros int64  `json:"jitterMicros"`
+	PingsSent    uint64 `json:"pingsSent"`
+	PingsLost    uint64 `json:"pingsLost"`
+	Stalled      bool   `json:"stalled"`
+	Resyncs      uint64 `json:"resyncs"`
+}
+
+func newSerialLinkMonitor(sio *SerialIO) *serialLinkMonitor {
+	return &serialLinkMonitor{
+		sio:     sio,
+		logger:  sio.logger.Named("link"),
+		pending: make(map[uint32]time.Time),
+	}
+}
+
+// start begins pinging a freshly connected controller
+func (lm *serialLinkMonitor) start() {
+	lm.mu.Lock()
+	defer lm.mu.Unlock()
+
+	now := time.Now()
+
+	lm.epoch = now
+	lm.pending = make(map[uint32]time.Time)
+	lm.srtt, lm.rttvar, lm.rtt = 0, 0, 0
+	lm.consecutiveLosses = 0
+	lm.pongSeen = false
+	lm.lastLineAt = now
+	lm.stalled = false
+	lm.deviceMillis = 0
+	lm.stop = make(chan struct{})
+
+	go lm.run(lm.stop)
+}
+
+// halt stops pinging, once the connection closes
+func (lm *serialLinkMonitor) halt() {
+	lm.mu.Lock()
+	defer lm.mu.Unlock()
+
+	if lm.stop != nil {
+		close(lm.stop)
+		lm.stop = nil
+	}
+}
+
+func (lm *serialLinkMonitor) run(stop chan struct{}) {
+	pingTicker := time.NewTicker(linkPingInterval)
+	defer pingTicker.Stop()
+
+	summaryTicker := time.NewTicker(linkSummaryInterval)
+	defer summaryTicker.Stop()
+
+	for {
+		select {
+		case <-stop:
+			return
+		case <-pingTicker.C:
+			lm.check()
+			lm.ping()
+		case <-summaryTicker.C:
+			snapshot := lm.snapshot()
+			lm.logger.Infow("Link health",
+				"rtt", time.Duration(snapshot.RTTMicros)*time.Microsecond,
+				"jitter", time.Duration(snapshot.JitterMicros)*time.Microsecond,
+				"pingsSent", snapshot.PingsSent,
+				"pingsLost", snapshot.PingsLost,
+				"resyncs", snapshot.Resyncs)
+		}
+	}
+}
+
+func (lm *serialLinkMonitor) ping() {
+	lm.mu.Lock()
+	lm.seq++
+	seq := lm.seq
+	now := time.Now()
+	lm.pending[seq] = now
+	lm.pingsSent++
+	hostMicros := now.Sub(lm.epoch).Microseconds()
+	lm.mu.Unlock()
+
+	if err := lm.sio.writeSerialLine(fmt.Sprintf("P:%d:%d", seq, hostMicros)); err != nil {
+		lm.logger.Debugw("Failed to send ping", "error", err)
+	}
+}
+
+// check expires unanswered pings and looks for stalls, resyncing the controller when the link degrades
+func (lm *serialLinkMonitor) check() {
+	lm.mu.Lock()
+
+	now := time.Now()
+	lost := 0
+
+	for seq, sentAt := range lm.pending {
+		if now.Sub(sentAt) > linkPingTimeout {
+			delete(lm.pending, seq)
+			lost++
+		}
+	}
+
+	lm.pingsLost += uint64(lost)
+	if lost > 0 {
+		lm.consecutiveLosses += lost
+	}
+
+	// controllers running older firmware never answer pings, that isn't a degraded link
+	degraded := lm.pongSeen && lm.consecutiveLosses >= linkMaxConsecutiveLosses
+	if degraded {
+		lm.consecutiveLosses = 0
+	}
+
+	silence := now.Sub(lm.lastLineAt)
+	stalledNow := !lm.stalled && silence > linkStallTimeout
+	if stalledNow {
+		lm.stalled = true
+	}
+
+	lm.mu.Unlock()
+
+	if stalledNow {
+		lm.logger.Warnw("Controller link stalled", "silence", silence)
+	}
+
+	if degraded {
+		lm.logger.Warnw("Controller link degraded, resyncing", "consecutiveLosses", linkMaxConsecutiveLosses)
+		lm.resync()
+	}
+}
+
+// onLine records that the controller is alive. called from the read loop for every line
+func (lm *serialLinkMonitor) onLine(now time.Time) {
+	lm.mu.Lock()
+	lm.lastLineAt = now
+	recovered := lm.stalled
+	lm.stalled = false
+	lm.mu.Unlock()
+
+	// whatever state the controller was in while it was silent, ours is what counts
+	if recovered {
+		lm.logger.Infow("Controller link recovered from stall, resyncing")
+		lm.resync()
+	}
+}
+
+// onPong handles a "Q:" line's payload. called from the read loop
+func (lm *serialLinkMonitor) onPong(logger *zap.SugaredLogger, payload string) {
+	parts := strings.Split(payload, ":")
+	if len(parts) < 2 {
+		logger.Debugw("Ignoring malformed pong", "payload", payload)
+		return
+	}
+
+	seq, err := strconv.ParseUint(parts[0], 10, 32)
+	if err != nil {
+		logger.Debugw("Ignoring pong with non-numeric sequence", "payload", payload)
+		return
+	}
+
+	var deviceMillis uint64
+	if len(parts) >= 3 {
+		deviceMillis, _ = strconv.ParseUint(parts[2], 10, 64)
+	}
+
+	var held time.Duration
+	if len(parts) >= 4 {
+		heldMicros, _ := strconv.ParseUint(parts[3], 10, 32)
+		held = time.Duration(heldMicros) * time.Microsecond
+	}
+
+	lm.mu.Lock()
+
+	sentAt, ok := lm.pending[uint32(seq)]
+	if !ok {
+
+		// answered after we gave up on it (or from before a reconnect)
+		lm.mu.Unlock()
+		return
+	}
+
+	delete(lm.pending, uint32(seq))
+
+	rtt := time.Since(sentAt)
+	if held < rtt {
+		rtt -= held
+	}
+	lm.rtt = rtt
+	lm.pongsReceived++
+	lm.consecutiveLosses = 0
+
+	if !lm.pongSeen {
+		lm.srtt = rtt
+		lm.rttvar = rtt / 2
+		lm.pongSeen = true
+	} else {
+		deviation := lm.srtt - rtt
+		if deviation < 0 {
+			deviation = -deviation
+		}
+
+		lm.rttvar = (3*lm.rttvar + deviation) / 4
+		lm.srtt = (7*lm.srtt + rtt) / 8
+	}
+
+	// the device's uptime going backwards means it rebooted and lost everything we sent it
+	rebooted := deviceMillis > 0 && deviceMillis < lm.deviceMillis
+	if deviceMillis > 0 {
+		lm.deviceMillis = deviceMillis
+	}
+
+	lm.mu.Unlock()
+
+	if lm.sio.deej.Verbose() {
+		logger.Debugw("Got pong", "seq", seq, "rtt", rtt)
+	}
+
+	if rebooted {
+		lm.logger.Infow("Controller rebooted, resyncing", "uptime", time.Duration(deviceMillis)*time.Millisecond)
+		lm.resync()
+	}
+}
+
+// resync brings the controller's lighting and (if enabled) slider positions back in line with deej's state.
+// the slider count is also reset, so the next line re-applies every knob's position to its sessions. when deej's
+// state is what counts, those positions (stale, or zero after a reboot) are held back like on connect, from before
+// the next line is read until the sync has put the knobs back. the sync itself runs in the background
+func (lm *serialLinkMonitor) resync() {
+	lm.mu.Lock()
+	lm.resyncs++
+	lm.mu.Unlock()
+
+	if lm.sio.deej.config.Snapshot().SendOnStartup {
+		lm.sio.suppressSliderEvents(startupSliderSuppress + stateReplyTimeout)
+	}
+
+	lm.sio.forgetNumSliders()
+	go lm.sio.syncState(lm.logger, true)
+}
+
+func (lm *serialLinkMonitor) snapshot() serialLinkSnapshot {
+	lm.mu.Lock()
+	defer lm.mu.Unlock()
+
+	return serialLinkSnapshot{
+		RTTMicros:    lm.srtt.Microseconds(),
+		JitterMicros: lm.rttvar.Microseconds(),
+		PingsSent:    lm.pingsSent,
+		PingsLost:    lm.pingsLost,
+		Stalled:      lm.stalled,
+		Resyncs:      lm.resyncs,
+	}
+}
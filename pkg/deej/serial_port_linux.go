@@ -0,0 +1,130 @@
+package deej
+
+import (
+	"errors"
+	"fmt"
+	"io"
+	"os"
+	"syscall"
+	"unsafe"
+)
+
+// asyncLowLatency is ASYNC_LOW_LATENCY from linux/tty_flags.h. usb-serial drivers (FTDI and friends) drop their
+// latency timer to 1ms for ports that have it, instead of holding received bytes back for up to 16ms
+const asyncLowLatency = 1 << 13
+
+// serialStruct mirrors struct serial_struct from linux/serial.h, as used by TIOCGSERIAL and TIOCSSERIAL
+type serialStruct struct {
+	Type          int32
+	Line          int32
+	Port          uint32
+	IRQ           int32
+	Flags         int32
+	XmitFIFOSize  int32
+	CustomDivisor int32
+	BaudBase      int32
+	CloseDelay    uint16
+	IOType        byte
+	ReservedChar  byte
+	Hub6          int32
+	ClosingWait   uint16
+	ClosingWait2  uint16
+	IOMemBase     uintptr
+	IOMemRegShift uint16
+	PortHigh      uint32
+	IOMapBase     uintptr
+}
+
+// tuneSerialPortLatency makes reads on an open serial port return as soon as any byte arrives, with everything
+// that's buffered (VMIN 1, VTIME 0), and asks the driver for low latency. drivers that don't support
+// low latency (like cdc_acm, which never delays) are left as they are
+func tuneSerialPortLatency(conn io.ReadWriteCloser) error {
+	file, ok := conn.(*os.File)
+	if !ok {
+		return errors.New("not a file")
+	}
+
+	fd := file.Fd()
+
+	var termios syscall.Termios
+	if err := ioctl(fd, syscall.TCGETS, unsafe.Pointer(&termios)); err != nil {
+		return fmt.Errorf("get termios: %w", err)
+	}
+
+	termios.Cc[syscall.VMIN] = 1
+	termios.Cc[syscall.VTIME] = 0
+
+	if err := ioctl(fd, syscall.TCSETS, unsafe.Pointer(&termios)); err != nil {
+		return fmt.Errorf("set termios: %w", err)
+	}
+
+	var serial serialStruct
+	if err := ioctl(fd, syscall.TIOCGSERIAL, unsafe.Pointer(&serial)); err != nil {
+		return fmt.Errorf("get serial info: %w", err)
+	}
+
+	if serial.Flags&asyncLowLatency != 0 {
+		return nil
+	}
+
+	serial.Flags |= asyncLowLatency
+
+	if err := ioctl(fd, syscall.TIOCSSERIAL, unsafe.Pointer(&serial)); err != nil {
+		return fmt.Errorf("set low latency: %w", err)
+	}
+
+	return nil
+}
+
+func ioctl(fd uintptr, request uintptr, arg unsafe.Pointer) error {
+	if _, _, errno := syscall.Syscall(syscall.SYS_IOCTL, fd, request, uintptr(arg)); errno != 0 {
+		return errno
+	}
+
+	return nil
+}
+
+// openPTY opens a pseudo terminal pair in raw mode, standing in for a controller's serial port in benchmarks
+func openPTY() (*os.File, *os.File, error) {
+	master, err := os.OpenFile("/dev/ptmx", os.O_RDWR|syscall.O_NOCTTY, 0)
+	if err != nil {
+		return nil, nil, fmt.Errorf("open ptmx: %w", err)
+	}
+
+	var unlock int32
+	if err := ioctl(master.Fd(), syscall.TIOCSPTLCK, unsafe.Pointer(&unlock)); err != nil {
+		master.Close()
+		return nil, nil, fmt.Errorf("unlock pty: %w", err)
+	}
+
+	var number uint32
+	if err := ioctl(master.Fd(), syscall.TIOCGPTN, unsafe.Pointer(&number)); err != nil {
+		master.Close()
+		return nil, nil, fmt.Errorf("get pty number: %w", err)
+	}
+
+	slave, err := os.OpenFile(fmt.Sprintf("/dev/pts/%d", number), os.O_RDWR|syscall.O_NOCTTY, 0)
+	if err != nil {
+		master.Close()
+		return nil, nil, fmt.Errorf("open pty: %w", err)
+	}
+
+	// raw mode, like a serial port opened for deej: no line editing, echo or newline translation
+	var termios syscall.Termios
+	if err := ioctl(slave.Fd(), syscall.TCGETS, unsafe.Pointer(&termios)); err == nil {
+		termios.Iflag &^= syscall.IGNBRK | syscall.BRKINT | syscall.PARMRK | syscall.ISTRIP | syscall.INLCR |
+			syscall.IGNCR | syscall.ICRNL | syscall.IXON
+		termios.Oflag &^= syscall.OPOST
+		termios.Lflag &^= syscall.ECHO | syscall.ECHONL | syscall.ICANON | syscall.ISIG | syscall.IEXTEN
+		termios.Cflag = termios.Cflag&^(syscall.CSIZE|syscall.PARENB) | syscall.CS8
+		err = ioctl(slave.Fd(), syscall.TCSETS, unsafe.Pointer(&termios))
+	}
+
+	if err != nil {
+		slave.Close()
+		master.Close()
+		return nil, nil, fmt.Errorf("set pty raw mode: %w", err)
+	}
+
+	return master, slave, nil
+}
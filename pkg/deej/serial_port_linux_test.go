@@ -0,0 +1,71 @@
+package deej
+
+import (
+	"io"
+	"sync"
+	"sync/atomic"
+	"testing"
+)
+
+// BenchmarkPTYLine measures a line's trip from the master side of a pty, through the kernel's tty layer and
+// the serial read loop, until it's been handled. the pty stands in for a controller's serial port
+func BenchmarkPTYLine(b *testing.B) {
+	device := newBenchmarkDevice(b)
+
+	master, slave, err := openPTY()
+	if err != nil {
+		b.Skipf("pty unavailable: %v", err)
+	}
+	defer master.Close()
+
+	// ptys have no low latency flag, only the read timing applies
+	tuneSerialPortLatency(slave)
+
+	var readMu sync.Mutex
+	done := make(chan struct{})
+	reader := &signallingReader{Reader: slave, reading: make(chan struct{}, 1)}
+
+	go device.readLines(device.logger, reader, &readMu, done)
+
+	defer func() {
+		readMu.Lock()
+		close(done)
+		readMu.Unlock()
+		slave.Close()
+	}()
+
+	lines := [][]byte{[]byte("0|512|1023|256\r\n"), []byte("1023|512|0|768\r\n")}
+
+	b.SetBytes(int64(len(lines[0])))
+	b.ReportAllocs()
+	b.ResetTimer()
+
+	for i := 0; i < b.N; i++ {
+		handled := atomic.LoadUint64(&device.stats.linesRead) + 1
+
+		if _, err := master.Write(lines[i&1]); err != nil {
+			b.Fatalf("write to pty: %v", err)
+		}
+
+		// wait without spinning, a spinning goroutine keeps the scheduler from polling the pty
+		for atomic.LoadUint64(&device.stats.linesRead) < handled {
+			<-reader.reading
+		}
+	}
+}
+
+// signallingReader signals whenever the read loop comes back for more, which it only does after
+// handling everything it read before
+type signallingReader struct {
+	io.Reader
+	reading chan struct{}
+}
+
+func (r *signallingReader) Read(p []byte) (int, error) {
+	select {
+	case r.reading <- struct{}{}:
+	default:
+	}
+
+	return r.Reader.Read(p)
+}
@@ -0,0 +1,17 @@
+package deej
+
+import (
+	"errors"
+	"io"
+	"os"
+)
+
+// tuneSerialPortLatency has nothing to tune on windows, where serial reads don't wait for a minimum size
+func tuneSerialPortLatency(conn io.ReadWriteCloser) error {
+	return nil
+}
+
+// openPTY isn't available on windows, so the pty benchmark is skipped there
+func openPTY() (*os.File, *os.File, error) {
+	return nil, nil, errors.New("ptys are only available on linux")
+}
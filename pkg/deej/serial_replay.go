@@ -0,0 +1,295 @@
+package deej
+
+import (
+	"errors"
+	"fmt"
+	"io"
+	"sort"
+	"sync/atomic"
+	"time"
+
+	"go.uber.org/zap"
+
+	"github.com/omriharel/deej/pkg/deej/util"
+)
+
+const (
+
+	// how many fake sessions a replay runs against
+	replayFakeSessions = 64
+
+	// sliders given a default mapping when replaying without a config file
+	replayDefaultSliders = 16
+)
+
+// SerialReplayReport summarizes a capture replay
+type SerialReplayReport struct {
+	Records    int
+	RXLines    int
+	RecordedTX int
+	ReplayedTX uint64
+	MoveEvents uint64
+
+	Duration       time.Duration
+	LinesPerSecond float64
+
+	// from the moment a line was due (or fed, if it wasn't late) until the session map finished handling its moves
+	LatencyP50 time.Duration
+	LatencyP95 time.Duration
+	LatencyP99 time.Duration
+	LatencyMax time.Duration
+}
+
+func (r SerialReplayReport) String() string {
+	return fmt.Sprintf("%d records (%d rx lines, %d tx recorded, %d tx replayed), %d move events in %s (%.0f lines/s), "+
+		"latency p50 %s, p95 %s, p99 %s, max %s",
+		r.Records, r.RXLines, r.RecordedTX, r.ReplayedTX, r.MoveEvents, r.Duration, r.LinesPerSecond,
+		r.LatencyP50, r.LatencyP95, r.LatencyP99, r.LatencyMax)
+}
+
+// replayConn stands in for a controller's serial connection, counting what deej writes to it
+type replayConn struct {
+	writes uint64
+}
+
+func (c *replayConn) Read(p []byte) (int, error) {
+	return 0, io.EOF
+}
+
+func (c *replayConn) Write(p []byte) (int, error) {
+	atomic.AddUint64(&c.writes, 1)
+	return len(p), nil
+}
+
+func (c *replayConn) Close() error {
+	return nil
+}
+
+// replayNotifier logs notifications instead of showing them, replays are meant to run unattended
+type replayNotifier struct {
+	logger *zap.SugaredLogger
+}
+
+func (n *replayNotifier) Notify(title string, message string) {
+	n.logger.Infow("Notification", "title", title, "message", message)
+}
+
+// ReplaySerialCapture feeds the controller lines from a capture file (see DEEJ_SERIAL_CAPTURE) back into deej's
+// serial handling, against fake audio sessions. a speed of 1 replays at the original pace, higher values replay
+// that many times faster, and 0 replays as fast as possible. configured commands aren't run during a replay
+func ReplaySerialCapture(logger *zap.SugaredLogger, path string, speed float64) (SerialReplayReport, error) {
+	logger = logger.Named("replay")
+	report := SerialReplayReport{}
+
+	if speed < 0 {
+		return report, errors.New("replay speed can't be negative")
+	}
+
+	records, err := readSerialCapture(path)
+	if err != nil {
+		return report, fmt.Errorf("read capture: %w", err)
+	}
+
+	controllerCount := 0
+	for _, record := range records {
+		if record.Controller+1 > controllerCount {
+			controllerCount = record.Controller + 1
+		}
+	}
+
+	d, conns, err := newReplayDeej(logger, controllerCount)
+	if err != nil {
+		return report, fmt.Errorf("set up replay: %w", err)
+	}
+	defer d.sessions.release()
+
+	// handle slider moves here rather than in the session map's own goroutine, so we know when each one is done
+	var handledEvents uint64
+	handledNotify := make(chan struct{}, 1)
+	sliderEvents := d.serial.SubscribeToSliderMoveEvents()
+
+	go func() {
+		for event := range sliderEvents {
+			d.sessions.handleSliderMoveEvent(event)
+			atomic.AddUint64(&handledEvents, 1)
+
+			select {
+			case handledNotify <- struct{}{}:
+			default:
+			}
+		}
+	}()
+
+	devices := d.serial.currentDevices()
+	latencies := make([]time.Duration, 0, len(records))
+	deliveredEvents := uint64(0)
+
+	logger.Infow("Replaying capture", "path", path, "records", len(records), "speed", speed)
+
+	start := time.Now()
+
+	for _, record := range records {
+		report.Records++
+
+		if record.Direction == serialCaptureTX {
+			report.RecordedTX++
+			continue
+		}
+
+		if record.Controller >= len(devices) {
+			continue
+		}
+
+		// when the replay falls behind schedule, the backlog counts towards latency. oversleeping doesn't
+		due := time.Now()
+		if speed > 0 {
+			scheduled := start.Add(time.Duration(float64(record.Offset) / speed))
+			if wait := time.Until(scheduled); wait > 0 {
+				time.Sleep(wait)
+				due = time.Now()
+			} else {
+				due = scheduled
+			}
+		}
+
+		device := devices[record.Controller]
+		movesBefore := atomic.LoadUint64(&device.stats.moveEvents)
+
+		device.handleLine(device.logger, record.Payload+"\n")
+		report.RXLines++
+
+		deliveredEvents += atomic.LoadUint64(&device.stats.moveEvents) - movesBefore
+		for atomic.LoadUint64(&handledEvents) < deliveredEvents {
+			<-handledNotify
+		}
+
+		latencies = append(latencies, time.Since(due))
+	}
+
+	report.Duration = time.Since(start)
+	report.MoveEvents = deliveredEvents
+
+	for _, conn := range conns {
+		report.ReplayedTX += atomic.LoadUint64(&conn.writes)
+	}
+
+	if seconds := report.Duration.Seconds(); seconds > 0 {
+		report.LinesPerSecond = float64(report.RXLines) / seconds
+	}
+
+	if len(latencies) > 0 {
+		sort.Slice(latencies, func(i, j int) bool { return latencies[i] < latencies[j] })
+
+		report.LatencyP50 = latencyPercentile(latencies, 50)
+		report.LatencyP95 = latencyPercentile(latencies, 95)
+		report.LatencyP99 = latencyPercentile(latencies, 99)
+		report.LatencyMax = latencies[len(latencies)-1]
+	}
+
+	logger.Infow("Replay finished", "report", report.String())
+
+	return report, nil
+}
+
+// newReplayDeej wires up just enough of deej to handle serial lines: config, fake sessions,
+// and the given number of connection-less SerialIO instances
+func newReplayDeej(logger *zap.SugaredLogger, controllerCount int) (*Deej, []*replayConn, error) {
+	notifier := &replayNotifier{logger: logger}
+
+	config, err := NewConfig(logger, notifier)
+	if err != nil {
+		return nil, nil, fmt.Errorf("create new Config: %w", err)
+	}
+
+	d := &Deej{
+		logger:   logger,
+		notifier: notifier,
+		config:   config,
+	}
+
+	if util.FileExists(userConfigFilepath) {
+		if err := config.Load(); err != nil {
+			return nil, nil, fmt.Errorf("load config: %w", err)
+		}
+	} else {
+		if err := config.populateFromVipers(); err != nil {
+			return nil, nil, fmt.Errorf("populate default config: %w", err)
+		}
+
+	}
+
+	// replays publish their own copy of the loaded config
+	snapshot := *config.Snapshot()
+
+	if !util.FileExists(userConfigFilepath) {
+		snapshot.SliderMapping = replayDefaultSliderMapping()
+		logger.Infow("No config file found, using a default mapping", "sliderMapping", snapshot.SliderMapping)
+	}
+
+	// a benchmark shouldn't launch anything
+	snapshot.Commands = map[int]CommandSpec{}
+	snapshot.Gestures = map[string]CommandSpec{}
+	config.publish(&snapshot)
+
+	controllers := make([]ControllerConfig, controllerCount)
+	for idx := range controllers {
+		if idx < len(snapshot.Controllers) {
+			controllers[idx] = snapshot.Controllers[idx]
+		} else {
+			controllers[idx] = ControllerConfig{COMPort: fmt.Sprintf("replay-%d", idx)}
+		}
+	}
+
+	d.configUI = newConfigUIService(d, logger)
+	d.outputActions = newOutputActionQueues(d, logger)
+	d.serial = &serialControllers{
+		deej:                d,
+		logger:              logger.Named("controllers"),
+		sliderMoveConsumers: []chan SliderMoveEvent{},
+	}
+
+	devices, err := d.serial.buildDevices(controllers)
+	if err != nil {
+		return nil, nil, err
+	}
+
+	conns := make([]*replayConn, len(devices))
+	for idx, device := range devices {
+		conns[idx] = &replayConn{}
+		device.conn = conns[idx]
+		device.setConnected(true)
+	}
+	d.serial.devices = devices
+
+	if d.sessions, err = newSessionMap(d, logger, newFakeSessionFinder(logger, replayFakeSessions, 0)); err != nil {
+		return nil, nil, fmt.Errorf("create new sessionMap: %w", err)
+	}
+
+	d.sessions.rebuildMappedKeys()
+	if err := d.sessions.getAndAddSessions(); err != nil {
+		return nil, nil, fmt.Errorf("get fake sessions: %w", err)
+	}
+
+	return d, conns, nil
+}
+
+// replayDefaultSliderMapping maps the first slider to master and the rest to fake app sessions
+func replayDefaultSliderMapping() *sliderMap {
+	mapping := newSliderMap()
+	mapping.set(0, []string{masterSessionName})
+
+	for sliderIdx := 1; sliderIdx < replayDefaultSliders; sliderIdx++ {
+		mapping.set(sliderIdx, []string{fmt.Sprintf(fakeSessionNameFormat, sliderIdx-1)})
+	}
+
+	return mapping
+}
+
+func latencyPercentile(sorted []time.Duration, percentile int) time.Duration {
+	idx := (len(sorted)*percentile+99)/100 - 1
+	if idx < 0 {
+		idx = 0
+	}
+
+	return sorted[idx]
+}
@@ -0,0 +1,364 @@
+package deej
+
+import (
+	"fmt"
+	"hash/fnv"
+	"strconv"
+	"strings"
+	"time"
+
+	"go.uber.org/zap"
+)
+
+const (
+
+	// how long a state sync waits for the controller to report its state. firmware that doesn't
+	// support state dumps never answers, and gets everything sent to it once this passes
+	stateReplyTimeout = 500 * time.Millisecond
+
+	// the firmware's background modes, as they're hashed
+	controllerBackgroundOff   = 0
+	controllerBackgroundSolid = 1
+	controllerBackgroundRGB   = 2
+
+	// colors the firmware shows for sliders it hasn't been given a color mapping for
+	controllerDefaultZeroColor = "#320000"
+	controllerDefaultFullColor = "#003200"
+)
+
+// controllerState is the controller's report of what it currently shows, as
+// "S:<max position>:<positions>:<muted mask>:<outputs>:<background hash>:<colors hash>[:<animations hash>]":
+//
+//	positions:  each encoder's position (0 to max position), comma separated
+//	muted mask: hex bitmask of muted encoders (bit 0 is the first encoder)
+//	outputs:    the selected output (1-based, 0 for none) of each button group, comma separated
+//
+// both hashes are FNV-1a (32 bit) over the applied lighting state's bytes:
+//
+//	background: mode (0 off, 1 solid, 2 rgb), followed by r, g, b for a solid color
+//	colors:     for every encoder, zero color r, g, b followed by full color r, g, b
+//
+// firmware without animation support doesn't report the animations hash (see expectedAnimationHash)
+type controllerState struct {
+	positions  []float32
+	muted      []bool
+	outputs    []int
+	background uint32
+	colors     uint32
+
+	animations         uint32
+	animationsReported bool
+}
+
+// syncOnConnect brings a freshly connected controller up to date
+func (sio *SerialIO) syncOnConnect(logger *zap.SugaredLogger) {
+	sio.syncState(logger, true)
+}
+
+// syncState asks the controller what it currently shows, and only sends what differs from deej's state:
+// lighting sections whose hashes don't match and, with volumes, slider positions that aren't where they
+// should be. controllers that don't report their state get everything
+func (sio *SerialIO) syncState(logger *zap.SugaredLogger, volumes bool) {
+	if !sio.deej.config.Snapshot().SendOnStartup {
+		return
+	}
+
+	// one sync at a time, so concurrent syncs don't take each other's replies
+	sio.syncMu.Lock()
+	defer sio.syncMu.Unlock()
+
+	reported, ok := sio.requestState()
+	if !ok {
+		logger.Debug("Controller didn't report its state, sending full state")
+
+		if err := sio.sendLightingConfiguration(logger); err != nil {
+			logger.Warnw("Failed to send lighting configuration", "error", err)
+		}
+
+		if volumes {
+			sio.resetSliderDisplayCache()
+			if err := sio.sendInitialSliderVolumes(logger); err != nil {
+				logger.Warnw("Failed to send initial slider volumes", "error", err)
+			}
+		}
+
+		return
+	}
+
+	logger.Debugw("Controller reported its state",
+		"positions", reported.positions,
+		"muted", reported.muted,
+		"outputs", reported.outputs)
+
+	if err := sio.syncLighting(logger, reported); err != nil {
+		logger.Warnw("Failed to send lighting configuration", "error", err)
+	}
+
+	if volumes {
+		sio.seedSliderDisplayCache(reported)
+		if err := sio.sendInitialSliderVolumes(logger); err != nil {
+			logger.Warnw("Failed to send initial slider volumes", "error", err)
+		}
+	}
+}
+
+func (sio *SerialIO) syncLighting(logger *zap.SugaredLogger, reported controllerState) error {
+	encoders := len(reported.positions)
+
+	expectedBackground, backgroundConfigured := sio.expectedBackgroundHash()
+	backgroundDiffers := backgroundConfigured && expectedBackground != reported.background
+	colorsDiffer := sio.expectedColorsHash(encoders) != reported.colors
+	animationsDiffer := reported.animationsReported && sio.expectedAnimationHash() != reported.animations
+
+	logger.Debugw("Compared controller lighting state",
+		"backgroundDiffers", backgroundDiffers,
+		"colorsDiffer", colorsDiffer,
+		"animationsDiffer", animationsDiffer)
+
+	if backgroundDiffers {
+		if err := sio.sendBackgroundLighting(logger); err != nil {
+			return err
+		}
+	}
+
+	if colorsDiffer {
+		if err := sio.sendAllEncoderColors(logger, encoders); err != nil {
+			return err
+		}
+	}
+
+	if animationsDiffer {
+		if err := sio.sendAnimations(logger); err != nil {
+			return err
+		}
+	}
+
+	return nil
+}
+
+// seedSliderDisplayCache replaces the guessed slider positions with the ones the controller reported,
+// so only positions that are actually off get sent. a muted encoder shows (and reports to deej) zero
+func (sio *SerialIO) seedSliderDisplayCache(reported controllerState) {
+	sio.lastSentSliderPositionsMu.Lock()
+	defer sio.lastSentSliderPositionsMu.Unlock()
+
+	sio.lastSentSliderPositions = make(map[int]float32, len(reported.positions))
+
+	for localIdx, position := range reported.positions {
+		if sio.sliderLimit > 0 && localIdx >= sio.sliderLimit {
+			break
+		}
+
+		if reported.muted[localIdx] {
+			position = 0
+		}
+
+		sio.lastSentSliderPositions[localIdx] = position
+	}
+}
+
+// requestState asks the controller for a state dump and waits for the read loop to hand it over
+func (sio *SerialIO) requestState() (controllerState, bool) {
+
+	// drop a stale reply, if any
+	select {
+	case <-sio.stateReplies:
+	default:
+	}
+
+	if err := sio.writeSerialLine("S:"); err != nil {
+		return controllerState{}, false
+	}
+
+	select {
+	case reported := <-sio.stateReplies:
+		return reported, true
+	case <-time.After(stateReplyTimeout):
+		return controllerState{}, false
+	}
+}
+
+// onStateDump handles an "S:" line's payload. called from the read loop
+func (sio *SerialIO) onStateDump(logger *zap.SugaredLogger, payload string) {
+	reported, err := parseControllerState(payload)
+	if err != nil {
+		logger.Debugw("Ignoring malformed state dump", "payload", payload, "error", err)
+		return
+	}
+
+	select {
+	case sio.stateReplies <- reported:
+	default:
+	}
+}
+
+func parseControllerState(payload string) (controllerState, error) {
+	parts := strings.Split(payload, ":")
+	if len(parts) != 6 && len(parts) != 7 {
+		return controllerState{}, fmt.Errorf("expected 6 or 7 fields, got %d", len(parts))
+	}
+
+	maxPosition, err := strconv.Atoi(parts[0])
+	if err != nil || maxPosition <= 0 {
+		return controllerState{}, fmt.Errorf("invalid max position %q", parts[0])
+	}
+
+	reported := controllerState{}
+
+	if parts[1] != "" {
+		for _, field := range strings.Split(parts[1], ",") {
+			position, err := strconv.Atoi(field)
+			if err != nil || position < 0 || position > maxPosition {
+				return controllerState{}, fmt.Errorf("invalid position %q", field)
+			}
+
+			reported.positions = append(reported.positions, float32(float64(position)/float64(maxPosition)))
+		}
+	}
+
+	mutedMask, err := strconv.ParseUint(parts[2], 16, 64)
+	if err != nil {
+		return controllerState{}, fmt.Errorf("invalid muted mask %q: %w", parts[2], err)
+	}
+
+	reported.muted = make([]bool, len(reported.positions))
+	for idx := range reported.muted {
+		reported.muted[idx] = idx < 64 && mutedMask&(1<<uint(idx)) != 0
+	}
+
+	if parts[3] != "" {
+		for _, field := range strings.Split(parts[3], ",") {
+			output, err := strconv.Atoi(field)
+			if err != nil || output < 0 {
+				return controllerState{}, fmt.Errorf("invalid output selection %q", field)
+			}
+
+			reported.outputs = append(reported.outputs, output)
+		}
+	}
+
+	background, err := strconv.ParseUint(parts[4], 16, 32)
+	if err != nil {
+		return controllerState{}, fmt.Errorf("invalid background hash %q: %w", parts[4], err)
+	}
+
+	colors, err := strconv.ParseUint(parts[5], 16, 32)
+	if err != nil {
+		return controllerState{}, fmt.Errorf("invalid colors hash %q: %w", parts[5], err)
+	}
+
+	reported.background = uint32(background)
+	reported.colors = uint32(colors)
+
+	if len(parts) == 7 {
+		animations, err := strconv.ParseUint(parts[6], 16, 32)
+		if err != nil {
+			return controllerState{}, fmt.Errorf("invalid animations hash %q: %w", parts[6], err)
+		}
+
+		reported.animations = uint32(animations)
+		reported.animationsReported = true
+	}
+
+	return reported, nil
+}
+
+// expectedBackgroundHash hashes the background the controller shows after receiving our configuration.
+// without a configured background nothing is sent, so whatever the controller shows is fine
+func (sio *SerialIO) expectedBackgroundHash() (uint32, bool) {
+	background := strings.TrimSpace(sio.deej.config.Snapshot().BackgroundLighting)
+	if background == "" {
+		return 0, false
+	}
+
+	hash := fnv.New32a()
+
+	switch {
+	case strings.EqualFold(background, "rgb"):
+		hash.Write([]byte{controllerBackgroundRGB})
+	case strings.EqualFold(background, "off"):
+		hash.Write([]byte{controllerBackgroundOff})
+	default:
+		color := controllerColor(background)
+		hash.Write([]byte{controllerBackgroundSolid, color[0], color[1], color[2]})
+	}
+
+	return hash.Sum32(), true
+}
+
+// expectedColorsHash hashes the slider colors the controller shows after receiving all of ours
+func (sio *SerialIO) expectedColorsHash(encoders int) uint32 {
+	hash := fnv.New32a()
+
+	for localIdx := 0; localIdx < encoders; localIdx++ {
+		zero, full := sio.encoderColors(localIdx)
+		zeroColor, fullColor := controllerColor(zero), controllerColor(full)
+
+		hash.Write(zeroColor[:])
+		hash.Write(fullColor[:])
+	}
+
+	return hash.Sum32()
+}
+
+// sendAllEncoderColors sends colors for each of the controller's sliders, including the firmware's defaults
+// for sliders without a color mapping - so a removed mapping doesn't leave its old colors behind
+func (sio *SerialIO) sendAllEncoderColors(logger *zap.SugaredLogger, encoders int) error {
+	for localIdx := 0; localIdx < encoders; localIdx++ {
+		zero, full := sio.encoderColors(localIdx)
+
+		if err := sio.writeSerialLine(fmt.Sprintf("C:%d:%s:%s", localIdx, zero, full)); err != nil {
+			return fmt.Errorf("send color mapping for slider %d: %w", sio.controller.SliderOffset+localIdx, err)
+		}
+
+		if sio.deej.Verbose() {
+			logger.Debugw("Sent color mapping", "slider", sio.controller.SliderOffset+localIdx, "zero", zero, "full", full)
+		}
+	}
+
+	return nil
+}
+
+// encoderColors returns the colors one of this controller's sliders should show. sliders past the
+// controller's window aren't mapped to anything, so they keep the firmware's defaults
+func (sio *SerialIO) encoderColors(localIdx int) (string, string) {
+	if sio.sliderLimit > 0 && localIdx >= sio.sliderLimit {
+		return controllerDefaultZeroColor, controllerDefaultFullColor
+	}
+
+	entry, ok := sio.deej.config.Snapshot().ColorMapping[sio.controller.SliderOffset+localIdx]
+	if !ok {
+		return controllerDefaultZeroColor, controllerDefaultFullColor
+	}
+
+	zero := strings.TrimSpace(entry.Zero)
+	full := strings.TrimSpace(entry.Full)
+	if zero == "" || full == "" {
+		return controllerDefaultZeroColor, controllerDefaultFullColor
+	}
+
+	return zero, full
+}
+
+// controllerColor parses a color the way the firmware does: "#rrggbb", "rrggbb", "0xrrggbb" or "#rgb".
+// anything else is black
+func controllerColor(value string) [3]byte {
+	hex := strings.TrimSpace(value)
+	hex = strings.TrimPrefix(strings.TrimPrefix(hex, "0x"), "0X")
+	hex = strings.TrimPrefix(hex, "#")
+
+	if len(hex) == 3 {
+		hex = string([]byte{hex[0], hex[0], hex[1], hex[1], hex[2], hex[2]})
+	}
+
+	if len(hex) != 6 {
+		return [3]byte{}
+	}
+
+	number, err := strconv.ParseUint(hex, 16, 32)
+	if err != nil {
+		return [3]byte{}
+	}
+
+	return [3]byte{byte(number >> 16), byte(number >> 8), byte(number)}
+}
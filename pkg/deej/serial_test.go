@@ -0,0 +1,35 @@
+package deej
+
+import (
+	"testing"
+)
+
+// newBenchmarkDevice returns a controller connected to an in-memory serial connection, with the replay's
+// default mapping over fake sessions
+func newBenchmarkDevice(b *testing.B) *SerialIO {
+	return newBenchmarkDeej(b, replayFakeSessions, 0).serial.currentDevices()[0]
+}
+
+func BenchmarkHandleLine(b *testing.B) {
+	device := newBenchmarkDevice(b)
+	lines := [][]byte{[]byte("0|512|1023|256\r\n"), []byte("1023|512|0|768\r\n")}
+
+	b.ReportAllocs()
+	b.ResetTimer()
+
+	for i := 0; i < b.N; i++ {
+		device.handleLineBytes(device.logger, lines[i&1])
+	}
+}
+
+func BenchmarkSendSliderDisplayValue(b *testing.B) {
+	device := newBenchmarkDevice(b)
+	values := []float32{0.25, 0.75}
+
+	b.ReportAllocs()
+	b.ResetTimer()
+
+	for i := 0; i < b.N; i++ {
+		device.SendSliderDisplayValue(0, values[i&1])
+	}
+}
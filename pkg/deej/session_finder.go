@@ -6,3 +6,8 @@ type SessionFinder interface {
 	Release() error
 	GetForegroundProcessName() (string, error)
 }
+
+// defaultDeviceSwitcher is implemented by session finders that can natively change the system's default devices
+type defaultDeviceSwitcher interface {
+	SwitchDefaultDevice(deviceName string, output bool, moveStreams bool) (Session, error)
+}
@@ -0,0 +1,123 @@
+package deej
+
+import (
+	"fmt"
+	"math"
+	"sync/atomic"
+	"time"
+
+	"go.uber.org/zap"
+)
+
+const (
+
+	// fake sessions share process names in groups of this size, like multi-process apps do
+	fakeSessionsPerProcess = 4
+
+	// process name of each group of fake sessions, by group index
+	fakeSessionNameFormat = "fake-app-%03d"
+)
+
+// fakeSessionFinder stands in for the system's audio sessions where deej's serial handling and session map run
+// without an audio server: serial capture replays, the firmware loop and benchmarks
+type fakeSessionFinder struct {
+	logger        *zap.SugaredLogger
+	sessionLogger *zap.SugaredLogger
+
+	count int
+
+	// added to every request (each enumerated session, volume get and set), like an audio server's round-trip
+	latency time.Duration
+
+	// the master and mic sessions outlive refreshes, like they would on a real audio server
+	masterOut *fakeSession
+	masterIn  *fakeSession
+}
+
+type fakeSession struct {
+	baseSession
+
+	latency time.Duration
+	volume  uint32
+}
+
+func newFakeSessionFinder(logger *zap.SugaredLogger, count int, latency time.Duration) *fakeSessionFinder {
+	sf := &fakeSessionFinder{
+		logger:        logger.Named("session_finder"),
+		sessionLogger: logger.Named("sessions"),
+		count:         count,
+		latency:       latency,
+	}
+
+	sf.masterOut = sf.newSession(masterSessionName, true)
+	sf.masterIn = sf.newSession(inputSessionName, true)
+
+	sf.logger.Debugw("Created fake session finder instance", "count", count, "latency", latency)
+
+	return sf
+}
+
+func (sf *fakeSessionFinder) GetAllSessions() ([]Session, error) {
+	sessions := make([]Session, 0, sf.count+2)
+	sessions = append(sessions, sf.masterOut, sf.masterIn)
+
+	for sessionIdx := 0; sessionIdx < sf.count; sessionIdx++ {
+
+		// every enumerated session costs a round-trip on a real audio server
+		simulateLatency(sf.latency)
+
+		name := fmt.Sprintf(fakeSessionNameFormat, sessionIdx/fakeSessionsPerProcess)
+		sessions = append(sessions, sf.newSession(name, false))
+	}
+
+	return sessions, nil
+}
+
+func (sf *fakeSessionFinder) Release() error {
+	sf.logger.Debug("Released fake session finder instance")
+	return nil
+}
+
+func (sf *fakeSessionFinder) GetForegroundProcessName() (string, error) {
+	return "", nil
+}
+
+func (sf *fakeSessionFinder) newSession(name string, master bool) *fakeSession {
+	s := &fakeSession{
+		latency: sf.latency,
+		volume:  math.Float32bits(1),
+	}
+
+	s.name = name
+	s.master = master
+	s.humanReadableDesc = name
+	s.logger = sf.sessionLogger.Named(s.Key())
+
+	return s
+}
+
+func (s *fakeSession) GetVolume() float32 {
+	simulateLatency(s.latency)
+
+	return math.Float32frombits(atomic.LoadUint32(&s.volume))
+}
+
+func (s *fakeSession) SetVolume(v float32) error {
+	simulateLatency(s.latency)
+
+	atomic.StoreUint32(&s.volume, math.Float32bits(v))
+
+	return nil
+}
+
+func (s *fakeSession) Release() {}
+
+func (s *fakeSession) String() string {
+	return fmt.Sprintf(sessionStringFormat, s.humanReadableDesc, math.Float32frombits(atomic.LoadUint32(&s.volume)))
+}
+
+func simulateLatency(latency time.Duration) {
+	if latency > 0 {
+		time.Sleep(latency)
+	}
+}
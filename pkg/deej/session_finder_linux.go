@@ -12,12 +12,11 @@ import (
 )
 
 type paSessionFinder struct {
-	logger *zap.SugaredLogger
+	logger        *zap.SugaredLogger
+	sessionLogger *zap.SugaredLogger
 
-	wcaManager *wca.IAudioSessionManager2
-	wcaEvents  *wcaEvents
-
-	oleInitialized bool
+	client *proto.Client
+	conn   net.Conn
 }
 
 func (sf *paSessionFinder) GetForegroundProcessName() (string, error) {
@@ -82,6 +81,33 @@ func (sf *paSessionFinder) GetAllSessions() ([]Session, error) {
 	return sessions, nil
 }
 
+// SwitchDefaultDevice makes the named sink (output) or source (input) the server's default,
+// optionally moving all playing streams over to the new sink. it returns the new master session
+func (sf *paSessionFinder) SwitchDefaultDevice(deviceName string, output bool, moveStreams bool) (Session, error) {
+	if !output {
+		if err := sf.client.Request(&proto.SetDefaultSource{SourceName: deviceName}, nil); err != nil {
+			sf.logger.Warnw("Failed to set default source", "source", deviceName, "error", err)
+			return nil, fmt.Errorf("set default source: %w", err)
+		}
+
+		return sf.getMasterSourceSession()
+	}
+
+	if err := sf.client.Request(&proto.SetDefaultSink{SinkName: deviceName}, nil); err != nil {
+		sf.logger.Warnw("Failed to set default sink", "sink", deviceName, "error", err)
+		return nil, fmt.Errorf("set default sink: %w", err)
+	}
+
+	// moved streams keep their sink input index, so their existing sessions remain valid
+	if moveStreams {
+		if err := sf.moveSinkInputs(deviceName); err != nil {
+			sf.logger.Warnw("Failed to move sink inputs to new default sink", "sink", deviceName, "error", err)
+		}
+	}
+
+	return sf.getMasterSinkSession()
+}
+
 func (sf *paSessionFinder) Release() error {
 	if err := sf.conn.Close(); err != nil {
 		sf.logger.Warnw("Failed to close PulseAudio connection", "error", err)
@@ -127,6 +153,33 @@ func (sf *paSessionFinder) getMasterSourceSession() (Session, error) {
 	return source, nil
 }
 
+func (sf *paSessionFinder) moveSinkInputs(sinkName string) error {
+	request := proto.GetSinkInputInfoList{}
+	reply := proto.GetSinkInputInfoListReply{}
+
+	if err := sf.client.Request(&request, &reply); err != nil {
+		return fmt.Errorf("get sink input list: %w", err)
+	}
+
+	for _, info := range reply {
+		move := proto.MoveSinkInput{
+			SinkInputIndex: info.SinkInputIndex,
+			DeviceIndex:    proto.Undefined,
+			DeviceName:     sinkName,
+		}
+
+		// keep going - a stream may simply have ended in the meantime
+		if err := sf.client.Request(&move, nil); err != nil {
+			sf.logger.Debugw("Failed to move sink input",
+				"sinkInputIndex", info.SinkInputIndex,
+				"sink", sinkName,
+				"error", err)
+		}
+	}
+
+	return nil
+}
+
 func (sf *paSessionFinder) enumerateAndAddSessions(sessions *[]Session) error {
 	request := proto.GetSinkInputInfoList{}
 	reply := proto.GetSinkInputInfoListReply{}
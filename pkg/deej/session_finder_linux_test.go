@@ -0,0 +1,115 @@
+package deej
+
+import (
+	"os/exec"
+	"strings"
+	"testing"
+
+	"go.uber.org/zap"
+)
+
+const testNullSinkName = "deej_test_null_sink"
+
+// loadTestNullSink adds a null sink to the running PulseAudio (or PipeWire) server for the duration of the test,
+// and puts back the default sink and source afterwards. the test is skipped when there's no server to load it into
+func loadTestNullSink(t *testing.T) {
+	if _, err := exec.LookPath("pactl"); err != nil {
+		t.Skip("pactl not available")
+	}
+
+	defaultSink, defaultSource := pactlDefaults(t)
+
+	output, err := exec.Command("pactl", "load-module", "module-null-sink", "sink_name="+testNullSinkName).Output()
+	if err != nil {
+		t.Skipf("can't load module-null-sink: %v", err)
+	}
+
+	moduleIndex := strings.TrimSpace(string(output))
+
+	t.Cleanup(func() {
+		if defaultSink != "" {
+			exec.Command("pactl", "set-default-sink", defaultSink).Run()
+		}
+		if defaultSource != "" {
+			exec.Command("pactl", "set-default-source", defaultSource).Run()
+		}
+
+		if err := exec.Command("pactl", "unload-module", moduleIndex).Run(); err != nil {
+			t.Errorf("unload null sink module %s: %v", moduleIndex, err)
+		}
+	})
+}
+
+// pactlDefaults reads the server's default sink and source names
+func pactlDefaults(t *testing.T) (string, string) {
+	output, err := exec.Command("pactl", "info").Output()
+	if err != nil {
+		t.Skipf("can't reach the PulseAudio server: %v", err)
+	}
+
+	var sink, source string
+	for _, line := range strings.Split(string(output), "\n") {
+		if value := strings.TrimPrefix(line, "Default Sink: "); value != line {
+			sink = strings.TrimSpace(value)
+		}
+		if value := strings.TrimPrefix(line, "Default Source: "); value != line {
+			source = strings.TrimSpace(value)
+		}
+	}
+
+	return sink, source
+}
+
+func TestSwitchDefaultDeviceToNullSink(t *testing.T) {
+	loadTestNullSink(t)
+
+	sf, err := newSessionFinder(zap.NewNop().Sugar())
+	if err != nil {
+		t.Fatalf("create session finder: %v", err)
+	}
+	defer sf.Release()
+
+	switcher, ok := sf.(defaultDeviceSwitcher)
+	if !ok {
+		t.Fatal("PulseAudio session finder doesn't switch default devices")
+	}
+
+	sink, err := switcher.SwitchDefaultDevice(testNullSinkName, true, true)
+	if err != nil {
+		t.Fatalf("switch default sink: %v", err)
+	}
+	defer sink.Release()
+
+	if sink.Key() != masterSessionName {
+		t.Errorf("switching the sink returned session %q, want %q", sink.Key(), masterSessionName)
+	}
+
+	// every null sink comes with a monitor source
+	source, err := switcher.SwitchDefaultDevice(testNullSinkName+".monitor", false, false)
+	if err != nil {
+		t.Fatalf("switch default source: %v", err)
+	}
+	defer source.Release()
+
+	if source.Key() != inputSessionName {
+		t.Errorf("switching the source returned session %q, want %q", source.Key(), inputSessionName)
+	}
+
+	defaultSink, defaultSource := pactlDefaults(t)
+	if defaultSink != testNullSinkName {
+		t.Errorf("default sink is %q after switching, want %q", defaultSink, testNullSinkName)
+	}
+	if defaultSource != testNullSinkName+".monitor" {
+		t.Errorf("default source is %q after switching, want %q", defaultSource, testNullSinkName+".monitor")
+	}
+
+	// the new master session controls the null sink's volume
+	if err := sink.SetVolume(0.5); err != nil {
+		t.Fatalf("set null sink volume: %v", err)
+	}
+
+	output, err := exec.Command("pactl", "get-sink-volume", testNullSinkName).Output()
+	if err == nil && !strings.Contains(string(output), "50%") {
+		t.Errorf("null sink volume is %q after setting it to 50%%", strings.TrimSpace(string(output)))
+	}
+}
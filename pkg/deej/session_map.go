@@ -1,11 +1,13 @@
 package deej
 
 import (
+	"errors"
 	"fmt"
 	"regexp"
 	"sort"
 	"strings"
 	"sync"
+	"sync/atomic"
 	"time"
 
 	"github.com/omriharel/deej/pkg/deej/util"
@@ -14,6 +16,10 @@ import (
 )
 
 type sessionMap struct {
+
+	// when the last refresh started, in unix nanoseconds. accessed atomically, and first in the struct to stay 64-bit aligned
+	lastSessionRefresh int64
+
 	deej   *Deej
 	logger *zap.SugaredLogger
 
@@ -22,13 +28,28 @@ type sessionMap struct {
 
 	sessionFinder SessionFinder
 
-	lastSessionRefresh time.Time
-	unmappedSessions   []Session
+	// the refresh in progress, if any. callers that want a refresh while one is running wait for it instead
+	refreshing *sessionRefresh
+	refreshMu  sync.Mutex
+
+	// lowercase keys of every plain (non-special) slider target, rebuilt whenever the config is (re)loaded
+	mappedKeys map[string]struct{}
+
+	// keys of sessions that aren't mapped to any slider, maintained as sessions are added and cleared.
+	// existing elements of unmappedKeys are never modified in place (only appended to, or replaced as a whole),
+	// so deej.unmapped can hand out the slice itself without copying it
+	unmappedKeySet map[string]struct{}
+	unmappedKeys   []string
 
 	sliderSyncStop     chan struct{}
 	sliderSyncStopOnce sync.Once
 }
 
+// sessionRefresh is one session enumeration, done is closed once its sessions have been swapped in
+type sessionRefresh struct {
+	done chan struct{}
+}
+
 const (
 	masterSessionName = "master" // master device volume
 	systemSessionName = "system" // system sounds volume
@@ -75,6 +96,7 @@ func newSessionMap(deej *Deej, logger *zap.SugaredLogger, sessionFinder SessionF
 		logger:         logger,
 		m:              make(map[string][]Session),
 		lock:           &sync.Mutex{},
+		unmappedKeySet: make(map[string]struct{}),
 		sessionFinder:  sessionFinder,
 		sliderSyncStop: make(chan struct{}),
 	}
@@ -85,6 +107,8 @@ func newSessionMap(deej *Deej, logger *zap.SugaredLogger, sessionFinder SessionF
 }
 
 func (m *sessionMap) initialize() error {
+	m.rebuildMappedKeys()
+
 	if err := m.getAndAddSessions(); err != nil {
 		m.logger.Warnw("Failed to get all sessions during session map initialization", "error", err)
 		return fmt.Errorf("get all sessions during init: %w", err)
@@ -110,13 +134,14 @@ func (m *sessionMap) release() error {
 	return nil
 }
 
-// assumes the session map is clean!
-// only call on a new session map or as part of refreshSessions which calls reset
+// getAndAddSessions enumerates all sessions into a new map, and swaps it in for the current one in a single step.
+// readers see either the old sessions or the new ones, never a half-filled map, and the old ones are released
+// after the swap. only call on a new session map or through refreshSessions, which keeps refreshes single-flight
 func (m *sessionMap) getAndAddSessions() error {
 
 	// mark that we're refreshing before anything else
-	m.lastSessionRefresh = time.Now()
-	m.unmappedSessions = nil
+	refreshStart := time.Now()
+	atomic.StoreInt64(&m.lastSessionRefresh, refreshStart.UnixNano())
 
 	sessions, err := m.sessionFinder.GetAllSessions()
 	if err != nil {
@@ -124,18 +149,37 @@ func (m *sessionMap) getAndAddSessions() error {
 		return fmt.Errorf("get sessions from SessionFinder: %w", err)
 	}
 
+	next := make(map[string][]Session, len(sessions))
+	for _, session := range sessions {
+		key := session.Key()
+		next[key] = append(next[key], session)
+	}
+
+	m.lock.Lock()
+
+	previous := m.m
+	m.m = next
+	m.unmappedKeySet = make(map[string]struct{})
+	m.unmappedKeys = nil
+
+	// in enumeration order, like the sessions themselves
 	for _, session := range sessions {
-		m.add(session)
+		m.trackIfUnmappedLocked(session.Key())
+	}
 
-		if !m.sessionMapped(session) {
-			m.logger.Debugw("Tracking unmapped session", "session", session)
-			m.unmappedSessions = append(m.unmappedSessions, session)
+	m.lock.Unlock()
+
+	m.logger.Debug("Releasing replaced audio sessions")
+	for _, replaced := range previous {
+		for _, session := range replaced {
+			session.Release()
 		}
 	}
 
-	m.logger.Infow("Got all audio sessions successfully", "sessionMap", m)
+	m.logger.Infow("Got all audio sessions successfully", "sessionMap", m, "took", time.Since(refreshStart))
+	m.deej.configUI.onSessionsChanged(m.listSessionKeys())
 
-	if m.deej.config.SyncVolumes {
+	if m.deej.config.Snapshot().SyncVolumes {
 		m.syncAllSliderVolumes()
 	}
 
@@ -150,6 +194,9 @@ func (m *sessionMap) setupOnConfigReload() {
 			select {
 			case <-configReloadedChannel:
 				m.logger.Info("Detected config reload, attempting to re-acquire all audio sessions")
+
+				// the mapping may have changed even if the refresh below is skipped, so re-index it first
+				m.rebuildMappedKeys()
 				m.refreshSessions(false)
 			}
 		}
@@ -169,73 +216,127 @@ func (m *sessionMap) setupOnSliderMove() {
 	}()
 }
 
+// refreshSessions re-enumerates all sessions. it's single-flight: while a refresh is running, callers
+// (slider moves, config reloads, the tray) wait for it to finish instead of starting their own.
 // performance: explain why force == true at every such use to avoid unintended forced refresh spams
 func (m *sessionMap) refreshSessions(force bool) {
+	m.refreshMu.Lock()
 
-	// make sure enough time passed since the last refresh, unless force is true in which case always clear
-	if !force && m.lastSessionRefresh.Add(minTimeBetweenSessionRefreshes).After(time.Now()) {
+	if inProgress := m.refreshing; inProgress != nil {
+		m.refreshMu.Unlock()
+
+		m.logger.Debug("Session refresh already in progress, waiting for it")
+		<-inProgress.done
 		return
 	}
 
-	// clear and release sessions first
-	m.clear()
+	// make sure enough time passed since the last refresh, unless force is true in which case always refresh
+	if !force && m.sinceLastRefresh() < minTimeBetweenSessionRefreshes {
+		m.refreshMu.Unlock()
+		return
+	}
+
+	refresh := &sessionRefresh{done: make(chan struct{})}
+	m.refreshing = refresh
+	m.refreshMu.Unlock()
 
 	if err := m.getAndAddSessions(); err != nil {
 		m.logger.Warnw("Failed to re-acquire all audio sessions", "error", err)
 	} else {
 		m.logger.Debug("Re-acquired sessions successfully")
 	}
+
+	m.refreshMu.Lock()
+	m.refreshing = nil
+	m.refreshMu.Unlock()
+
+	close(refresh.done)
+}
+
+// sinceLastRefresh is how long ago the last refresh started
+func (m *sessionMap) sinceLastRefresh() time.Duration {
+	return time.Since(time.Unix(0, atomic.LoadInt64(&m.lastSessionRefresh)))
+}
+
+// rebuildMappedKeys indexes the slider mapping's plain targets, and re-derives the unmapped set
+// from the sessions currently in the map (without asking the session finder for them again)
+func (m *sessionMap) rebuildMappedKeys() {
+	mappedKeys := make(map[string]struct{})
+
+	m.deej.config.Snapshot().SliderMapping.iterate(func(sliderIdx int, targets []string) {
+		for _, target := range targets {
+
+			// ignore special transforms
+			if m.targetHasSpecialTransform(target) {
+				continue
+			}
+
+			mappedKeys[strings.ToLower(target)] = struct{}{}
+		}
+	})
+
+	m.lock.Lock()
+	defer m.lock.Unlock()
+
+	m.mappedKeys = mappedKeys
+	m.unmappedKeySet = make(map[string]struct{})
+	m.unmappedKeys = nil
+
+	for key := range m.m {
+		m.trackIfUnmappedLocked(key)
+	}
+
+	m.logger.Debugw("Indexed slider mapping", "mappedKeys", len(mappedKeys), "unmappedSessionKeys", len(m.unmappedKeys))
 }
 
-// returns true if a session is not currently mapped to any slider, false otherwise
+// returns true if a session key is mapped to a slider, false otherwise.
 // special sessions (master, system, mic) and device-specific sessions always count as mapped,
 // even when absent from the config. this makes sense for every current feature that uses "unmapped sessions"
-func (m *sessionMap) sessionMapped(session Session) bool {
+func (m *sessionMap) sessionKeyMappedLocked(key string) bool {
 
 	// count master/system/mic as mapped
-	if funk.ContainsString([]string{masterSessionName, systemSessionName, inputSessionName}, session.Key()) {
+	if key == masterSessionName || key == systemSessionName || key == inputSessionName {
 		return true
 	}
 
-	// count device sessions as mapped
-	if deviceSessionKeyPattern.MatchString(session.Key()) {
+	// look through the actual mappings
+	if _, ok := m.mappedKeys[key]; ok {
 		return true
 	}
 
-	matchFound := false
-
-	// look through the actual mappings
-	m.deej.config.SliderMapping.iterate(func(sliderIdx int, targets []string) {
-		for _, target := range targets {
+	// count device sessions as mapped
+	return deviceSessionKeyPattern.MatchString(key)
+}
 
-			// ignore special transforms
-			if m.targetHasSpecialTransform(target) {
-				continue
-			}
+// trackIfUnmappedLocked adds a session key to the unmapped set, unless it's mapped or already tracked
+func (m *sessionMap) trackIfUnmappedLocked(key string) {
+	if _, ok := m.unmappedKeySet[key]; ok || m.sessionKeyMappedLocked(key) {
+		return
+	}
 
-			// safe to assume this has a single element because we made sure there's no special transform
-			target = m.resolveTarget(target)[0]
+	m.logger.Debugw("Tracking unmapped session", "key", key)
 
-			if target == session.Key() {
-				matchFound = true
-				return
-			}
-		}
-	})
+	m.unmappedKeySet[key] = struct{}{}
 
-	return matchFound
+	// appending only writes past the end of any slice previously handed out, so it's safe for their holders
+	m.unmappedKeys = append(m.unmappedKeys, key)
 }
 
 func (m *sessionMap) handleSliderMoveEvent(event SliderMoveEvent) {
+	if m.deej.Verbose() {
+		defer func(start time.Time) {
+			m.logger.Debugw("Handled slider move", "slider", event.SliderID, "took", time.Since(start))
+		}(time.Now())
+	}
 
 	// first of all, ensure our session map isn't moldy
-	if m.lastSessionRefresh.Add(maxTimeBetweenSessionRefreshes).Before(time.Now()) {
+	if m.sinceLastRefresh() > maxTimeBetweenSessionRefreshes {
 		m.logger.Debug("Stale session map detected on slider move, refreshing")
 		m.refreshSessions(true)
 	}
 
 	// get the targets mapped to this slider from the config
-	targets, ok := m.deej.config.SliderMapping.get(event.SliderID)
+	targets, ok := m.deej.config.Snapshot().SliderMapping.get(event.SliderID)
 
 	// if slider not found in config, silently ignore
 	if !ok {
@@ -286,7 +387,7 @@ func (m *sessionMap) handleSliderMoveEvent(event SliderMoveEvent) {
 	// processes could've opened since the last time this slider moved.
 	// if they haven't, the cooldown will take care to not spam it up
 	if !targetFound {
-		elapsed := time.Since(m.lastSessionRefresh)
+		elapsed := m.sinceLastRefresh()
 		if containsCurrentTarget && elapsed > currentTargetForceRefreshCooldown {
 			m.refreshSessions(true)
 		} else if elapsed > missingTargetForceRefreshCooldown {
@@ -305,7 +406,7 @@ func (m *sessionMap) handleSliderMoveEvent(event SliderMoveEvent) {
 
 // sliderVolume reports the current average volume for all sessions mapped to a slider.
 func (m *sessionMap) sliderVolume(sliderIdx int) (float32, bool) {
-	targets, ok := m.deej.config.SliderMapping.get(sliderIdx)
+	targets, ok := m.deej.config.Snapshot().SliderMapping.get(sliderIdx)
 	if !ok || len(targets) == 0 {
 		return 0, false
 	}
@@ -363,7 +464,7 @@ func (m *sessionMap) setupSliderVolumeSync() {
 		for {
 			select {
 			case <-ticker.C:
-				if !m.deej.config.SyncVolumes {
+				if !m.deej.config.Snapshot().SyncVolumes {
 					continue
 				}
 				m.syncAllSliderVolumes()
@@ -377,7 +478,7 @@ func (m *sessionMap) setupSliderVolumeSync() {
 func (m *sessionMap) syncAllSliderVolumes() {
 	indices := []int{}
 
-	m.deej.config.SliderMapping.iterate(func(sliderIdx int, _ []string) {
+	m.deej.config.Snapshot().SliderMapping.iterate(func(sliderIdx int, _ []string) {
 		indices = append(indices, sliderIdx)
 	})
 
@@ -402,6 +503,25 @@ func (m *sessionMap) syncAllSliderVolumes() {
 	}
 }
 
+// switchDefaultDevice changes the system's default output or input device through the session finder,
+// then swaps in the new master/mic session without re-enumerating every other session
+func (m *sessionMap) switchDefaultDevice(deviceName string, output bool, moveStreams bool) error {
+	switcher, ok := m.sessionFinder.(defaultDeviceSwitcher)
+	if !ok {
+		return errors.New("switching default devices isn't supported on this platform")
+	}
+
+	master, err := switcher.SwitchDefaultDevice(deviceName, output, moveStreams)
+	if err != nil {
+		return fmt.Errorf("switch default device: %w", err)
+	}
+
+	m.replace(master)
+	m.logger.Debugw("Switched default device", "device", deviceName, "output", output, "session", master)
+
+	return nil
+}
+
 func (m *sessionMap) targetHasSpecialTransform(target string) bool {
 	return strings.HasPrefix(target, specialTargetTransformPrefix)
 }
@@ -433,39 +553,40 @@ func (m *sessionMap) applyTargetTransform(specialTargetName string) []string {
 			return nil
 		}
 
-		// we could have gotten a non-lowercase names from that, so let's ensure we return ones that are lowercase
+		// we could have gotten a non-lowercase names from that, so let's ensure we return ones that are lowercase.
+		// the result is a shared snapshot, so build a new slice rather than lowercasing it in place
+		lowercaseNames := make([]string, len(currentWindowProcessNames))
 		for targetIdx, target := range currentWindowProcessNames {
-			currentWindowProcessNames[targetIdx] = strings.ToLower(target)
+			lowercaseNames[targetIdx] = strings.ToLower(target)
 		}
 
 		// remove dupes
-		return funk.UniqString(currentWindowProcessNames)
+		return funk.UniqString(lowercaseNames)
 
 	// get currently unmapped sessions
 	case specialTargetAllUnmapped:
-		targetKeys := make([]string, len(m.unmappedSessions))
-		for sessionIdx, session := range m.unmappedSessions {
-			targetKeys[sessionIdx] = session.Key()
-		}
+		m.lock.Lock()
+		defer m.lock.Unlock()
 
-		return targetKeys
+		return m.unmappedKeys
 	}
 
 	return nil
 }
 
-func (m *sessionMap) add(value Session) {
+// replace releases all sessions under the given session's key and stores it in their place
+func (m *sessionMap) replace(value Session) {
 	m.lock.Lock()
 	defer m.lock.Unlock()
 
 	key := value.Key()
 
-	existing, ok := m.m[key]
-	if !ok {
-		m.m[key] = []Session{value}
-	} else {
-		m.m[key] = append(existing, value)
+	for _, session := range m.m[key] {
+		session.Release()
 	}
+
+	m.m[key] = []Session{value}
+	m.trackIfUnmappedLocked(key)
 }
 
 func (m *sessionMap) get(key string) ([]Session, bool) {
@@ -476,23 +597,6 @@ func (m *sessionMap) get(key string) ([]Session, bool) {
 	return value, ok
 }
 
-func (m *sessionMap) clear() {
-	m.lock.Lock()
-	defer m.lock.Unlock()
-
-	m.logger.Debug("Releasing and clearing all audio sessions")
-
-	for key, sessions := range m.m {
-		for _, session := range sessions {
-			session.Release()
-		}
-
-		delete(m.m, key)
-	}
-
-	m.logger.Debug("Session map cleared")
-}
-
 func (m *sessionMap) String() string {
 	m.lock.Lock()
 	defer m.lock.Unlock()
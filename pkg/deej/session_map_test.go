@@ -0,0 +1,113 @@
+package deej
+
+import (
+	"fmt"
+	"testing"
+	"time"
+
+	"go.uber.org/zap"
+)
+
+// session counts the session map is measured at, from a quiet desktop to far more than anyone runs
+var benchmarkSessionCounts = []int{10, 100, 1000}
+
+// audio server round-trips the session map is measured against: none, a local server, and a busy one
+var benchmarkSessionLatencies = []time.Duration{0, 100 * time.Microsecond, time.Millisecond}
+
+// newBenchmarkDeej sets up deej's serial handling and session map against sessionCount fake sessions, with the
+// replay's default mapping: slider 0 controls master, and slider n the sessions of fake app n-1
+func newBenchmarkDeej(b *testing.B, sessionCount int, latency time.Duration) *Deej {
+	logger := zap.NewNop().Sugar()
+
+	d, _, err := newReplayDeej(logger, 1)
+	if err != nil {
+		b.Fatalf("set up deej: %v", err)
+	}
+
+	if err := d.sessions.release(); err != nil {
+		b.Fatalf("release replay sessions: %v", err)
+	}
+
+	snapshot := *d.config.Snapshot()
+	snapshot.SliderMapping = replayDefaultSliderMapping()
+	snapshot.SyncVolumes = false
+	d.config.publish(&snapshot)
+
+	if d.sessions, err = newSessionMap(d, logger, newFakeSessionFinder(logger, sessionCount, latency)); err != nil {
+		b.Fatalf("create session map: %v", err)
+	}
+
+	d.sessions.rebuildMappedKeys()
+	if err := d.sessions.getAndAddSessions(); err != nil {
+		b.Fatalf("get fake sessions: %v", err)
+	}
+
+	b.Cleanup(func() { d.sessions.release() })
+
+	return d
+}
+
+// runAtScale runs a benchmark against every combination of session count and audio server latency
+func runAtScale(b *testing.B, benchmark func(b *testing.B, d *Deej)) {
+	for _, count := range benchmarkSessionCounts {
+		for _, latency := range benchmarkSessionLatencies {
+			b.Run(fmt.Sprintf("sessions=%d/latency=%v", count, latency), func(b *testing.B) {
+				d := newBenchmarkDeej(b, count, latency)
+
+				b.ReportAllocs()
+				b.ResetTimer()
+
+				benchmark(b, d)
+			})
+		}
+	}
+}
+
+func BenchmarkRefreshSessions(b *testing.B) {
+	runAtScale(b, func(b *testing.B, d *Deej) {
+		for i := 0; i < b.N; i++ {
+			d.sessions.refreshSessions(true)
+		}
+	})
+}
+
+func BenchmarkSliderMove(b *testing.B) {
+	events := []SliderMoveEvent{{SliderID: 1, PercentValue: 0.25}, {SliderID: 1, PercentValue: 0.75}}
+
+	runAtScale(b, func(b *testing.B, d *Deej) {
+		for i := 0; i < b.N; i++ {
+			d.sessions.handleSliderMoveEvent(events[i&1])
+		}
+	})
+}
+
+// BenchmarkSessionMapped checks every session's key against the slider mapping, as refreshes and config
+// reloads do when they track unmapped sessions. most fake apps aren't mapped to anything
+func BenchmarkSessionMapped(b *testing.B) {
+	for _, count := range benchmarkSessionCounts {
+		b.Run(fmt.Sprintf("sessions=%d", count), func(b *testing.B) {
+			d := newBenchmarkDeej(b, count, 0)
+			keys := d.sessions.listSessionKeys()
+
+			b.ReportAllocs()
+			b.ResetTimer()
+
+			for i := 0; i < b.N; i++ {
+				d.sessions.lock.Lock()
+				d.sessions.sessionKeyMappedLocked(keys[i%len(keys)])
+				d.sessions.lock.Unlock()
+			}
+		})
+	}
+}
+
+func BenchmarkSliderVolume(b *testing.B) {
+	d := newBenchmarkDeej(b, replayFakeSessions, 0)
+
+	b.ReportAllocs()
+	b.ResetTimer()
+
+	for i := 0; i < b.N; i++ {
+		d.sessions.sliderVolume(1)
+	}
+}
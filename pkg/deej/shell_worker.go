@@ -0,0 +1,347 @@
+package deej
+
+import (
+	"bufio"
+	"errors"
+	"fmt"
+	"io"
+	"os"
+	"os/exec"
+	"path/filepath"
+	"strconv"
+	"strings"
+	"sync"
+	"time"
+
+	"go.uber.org/zap"
+
+	"github.com/omriharel/deej/pkg/deej/util"
+)
+
+const (
+
+	// a command that doesn't finish in this time is assumed to be stuck - its worker is killed and restarted
+	shellWorkerCommandTimeout = 30 * time.Second
+
+	// prefix of the line each worker prints once a command finishes, followed by a sequence number and exit code
+	shellWorkerDoneMarker = "__deej_done_"
+
+	// a worker that dies on its own after living at least this long is restarted right away, so the
+	// next button press finds a warm shell. workers that die faster than this are only restarted on demand
+	shellWorkerMinLifetimeForRestart = time.Second
+
+	// idle workers kept per shell type. commands that run at the same time (e.g. for different button groups)
+	// each get their own worker, and workers beyond this many are stopped once their command is done
+	shellWorkerMaxIdle = 4
+)
+
+var errShellWorkerDied = errors.New("shell worker exited")
+
+// shellWorkerPool keeps warm, long-lived shell processes per shell type, so shell commands
+// only pay for their own runtime instead of interpreter startup on every button press
+type shellWorkerPool struct {
+	logger *zap.SugaredLogger
+
+	mu   sync.Mutex
+	idle map[string][]*shellWorker
+
+	// bumped by stop, workers from an older generation are stopped instead of going back to idle
+	generation uint64
+}
+
+// shellWorker feeds commands to a single long-lived shell over stdin, and waits for a
+// completion marker on its output to know when (and how) each command finished. a worker runs
+// one command at a time, the pool hands it to a single caller until that command is done
+type shellWorker struct {
+	logger     *zap.SugaredLogger
+	args       []string
+	generation uint64
+
+	mu        sync.Mutex
+	cmd       *exec.Cmd
+	stdin     io.WriteCloser
+	lines     chan string
+	seq       uint64
+	closed    bool
+	startedAt time.Time
+}
+
+func newShellWorkerPool(logger *zap.SugaredLogger) *shellWorkerPool {
+	return &shellWorkerPool{
+		logger: logger.Named("shell-workers"),
+		idle:   make(map[string][]*shellWorker),
+	}
+}
+
+// defaultShellWorkerArgs returns the command line used to start a shell that reads commands from stdin
+func defaultShellWorkerArgs() []string {
+	if util.Windows() {
+		return []string{"powershell.exe", "-NoLogo", "-NoProfile", "-NonInteractive", "-Command", "-"}
+	}
+
+	return []string{"/bin/bash", "--noprofile", "--norc", "-s"}
+}
+
+// run executes a command line on an idle worker of the default shell, starting one if none is idle
+func (p *shellWorkerPool) run(commandLine string) (string, error) {
+	worker := p.acquire(defaultShellWorkerArgs())
+	defer p.release(worker)
+
+	return worker.run(commandLine)
+}
+
+// warmUp starts a worker of the default shell ahead of time so the first command doesn't pay for it
+func (p *shellWorkerPool) warmUp() {
+	worker := p.acquire(defaultShellWorkerArgs())
+	defer p.release(worker)
+
+	worker.mu.Lock()
+	defer worker.mu.Unlock()
+
+	if err := worker.ensureStartedLocked(); err != nil {
+		p.logger.Warnw("Failed to start shell worker", "shell", worker.args[0], "error", err)
+	}
+}
+
+// acquire takes an idle worker for the given shell, or creates one (its shell starts with its first command)
+func (p *shellWorkerPool) acquire(args []string) *shellWorker {
+	key := strings.Join(args, " ")
+
+	p.mu.Lock()
+	defer p.mu.Unlock()
+
+	if idle := p.idle[key]; len(idle) > 0 {
+		worker := idle[len(idle)-1]
+		p.idle[key] = idle[:len(idle)-1]
+
+		return worker
+	}
+
+	return &shellWorker{
+		logger:     p.logger.Named(strings.TrimSuffix(filepath.Base(args[0]), ".exe")),
+		args:       args,
+		generation: p.generation,
+	}
+}
+
+// release puts a worker back for the next command, or stops it if enough workers are idle already
+// or the pool was stopped in the meantime
+func (p *shellWorkerPool) release(worker *shellWorker) {
+	key := strings.Join(worker.args, " ")
+
+	p.mu.Lock()
+	keep := worker.generation == p.generation && len(p.idle[key]) < shellWorkerMaxIdle
+	if keep {
+		p.idle[key] = append(p.idle[key], worker)
+	}
+	p.mu.Unlock()
+
+	if !keep {
+		worker.mu.Lock()
+		worker.killLocked()
+		worker.mu.Unlock()
+	}
+}
+
+// stop terminates all idle workers, and any busy ones once their command is done. a later command will start them again
+func (p *shellWorkerPool) stop() {
+	p.mu.Lock()
+	idle := p.idle
+	p.idle = make(map[string][]*shellWorker)
+	p.generation++
+	p.mu.Unlock()
+
+	for _, workers := range idle {
+		for _, worker := range workers {
+			worker.mu.Lock()
+			worker.killLocked()
+			worker.mu.Unlock()
+		}
+	}
+}
+
+func (w *shellWorker) run(commandLine string) (string, error) {
+	w.mu.Lock()
+	if err := w.ensureStartedLocked(); err != nil {
+		w.mu.Unlock()
+		return "", fmt.Errorf("start shell worker: %w", err)
+	}
+
+	w.seq++
+	marker := shellWorkerDoneMarker + strconv.FormatUint(w.seq, 10) + ":"
+	stdin := w.stdin
+	lines := w.lines
+	w.mu.Unlock()
+
+	if _, err := io.WriteString(stdin, w.script(commandLine, marker)); err != nil {
+		w.mu.Lock()
+		w.killLocked()
+		w.mu.Unlock()
+
+		return "", fmt.Errorf("write command to shell worker: %w", err)
+	}
+
+	output := strings.Builder{}
+	timeout := time.NewTimer(shellWorkerCommandTimeout)
+	defer timeout.Stop()
+
+	for {
+		select {
+		case line, ok := <-lines:
+			if !ok {
+				return output.String(), errShellWorkerDied
+			}
+
+			// the marker may share a line with output that didn't end in a newline
+			markerIdx := strings.Index(line, marker)
+			if markerIdx < 0 {
+				output.WriteString(line)
+				output.WriteByte('\n')
+				continue
+			}
+
+			output.WriteString(line[:markerIdx])
+			result := strings.TrimRight(output.String(), "\n")
+
+			exitCode, err := strconv.Atoi(strings.TrimSpace(line[markerIdx+len(marker):]))
+			if err != nil {
+				return result, fmt.Errorf("parse shell worker exit code: %w", err)
+			}
+
+			if exitCode != 0 {
+				return result, fmt.Errorf("command exited with code %d", exitCode)
+			}
+
+			return result, nil
+
+		case <-timeout.C:
+			w.logger.Warnw("Command timed out, restarting shell worker", "timeout", shellWorkerCommandTimeout)
+
+			w.mu.Lock()
+			w.killLocked()
+			w.mu.Unlock()
+
+			return output.String(), fmt.Errorf("command timed out after %s", shellWorkerCommandTimeout)
+		}
+	}
+}
+
+// script wraps a command line so the shell prints our completion marker (with the exit status) right after it.
+// every command runs on its own, like it would in a fresh shell: bash runs it in a subshell, PowerShell in a
+// script block that restores the location afterwards, so variables, options and cd don't carry over to the next
+// command. its input is empty rather than the worker's stdin, which holds the commands that follow. the command
+// line sits on a line of its own, so a trailing comment can't swallow the wrapper
+func (w *shellWorker) script(commandLine string, marker string) string {
+	if util.Windows() {
+
+		// a blank line ends the multi-line statement, PowerShell reading from stdin waits for one
+		return fmt.Sprintf("$global:deejExit = 1; Push-Location; try { $null | & {\n%s\n"+
+			"$global:deejExit = if ($?) { 0 } else { 1 } } } finally { Pop-Location }\n\n"+
+			"Write-Output \"`n%s$global:deejExit\"\n", commandLine, marker)
+	}
+
+	return fmt.Sprintf("(\n%s\n) </dev/null\nprintf '\\n%s%%d\\n' \"$?\"\n", commandLine, marker)
+}
+
+func (w *shellWorker) ensureStartedLocked() error {
+	if w.cmd != nil && !w.closed {
+		return nil
+	}
+
+	cmd := exec.Command(w.args[0], w.args[1:]...)
+
+	stdin, err := cmd.StdinPipe()
+	if err != nil {
+		return fmt.Errorf("create stdin pipe: %w", err)
+	}
+
+	// stdout and stderr share one pipe, so a command's errors end up in its output
+	outputReader, outputWriter, err := os.Pipe()
+	if err != nil {
+		return fmt.Errorf("create output pipe: %w", err)
+	}
+
+	cmd.Stdout = outputWriter
+	cmd.Stderr = outputWriter
+
+	if err := cmd.Start(); err != nil {
+		outputReader.Close()
+		outputWriter.Close()
+		return fmt.Errorf("start shell: %w", err)
+	}
+
+	// the child has its own copy now
+	outputWriter.Close()
+
+	lines := make(chan string)
+
+	w.cmd = cmd
+	w.stdin = stdin
+	w.lines = lines
+	w.closed = false
+	w.startedAt = time.Now()
+
+	go w.readOutput(cmd, outputReader, lines)
+
+	w.logger.Debugw("Started shell worker", "args", w.args, "pid", cmd.Process.Pid)
+
+	return nil
+}
+
+func (w *shellWorker) readOutput(cmd *exec.Cmd, output io.ReadCloser, lines chan string) {
+	reader := bufio.NewReader(output)
+
+	for {
+		line, err := reader.ReadString('\n')
+		if line != "" {
+			lines <- strings.TrimRight(line, "\r\n")
+		}
+
+		if err != nil {
+			break
+		}
+	}
+
+	output.Close()
+	err := cmd.Wait()
+	close(lines)
+
+	w.mu.Lock()
+	defer w.mu.Unlock()
+
+	// killed on purpose (or already replaced) - nothing more to do
+	if w.cmd != cmd || w.closed {
+		return
+	}
+
+	w.closed = true
+	w.logger.Warnw("Shell worker exited unexpectedly", "error", err)
+
+	if time.Since(w.startedAt) < shellWorkerMinLifetimeForRestart {
+		return
+	}
+
+	if err := w.ensureStartedLocked(); err != nil {
+		w.logger.Warnw("Failed to restart shell worker", "error", err)
+	}
+}
+
+// killLocked terminates the current shell process, if any. the next command starts a fresh one
+func (w *shellWorker) killLocked() {
+	if w.cmd == nil || w.closed {
+		return
+	}
+
+	w.stdin.Close()
+	if err := w.cmd.Process.Kill(); err != nil {
+		w.logger.Debugw("Failed to kill shell worker", "error", err)
+	}
+
+	w.closed = true
+
+	// nobody waits for this worker's output anymore, let its reader run to completion
+	go func(lines chan string) {
+		for range lines {
+		}
+	}(w.lines)
+}
@@ -0,0 +1,89 @@
+package deej
+
+import (
+	"os"
+	"os/exec"
+	"testing"
+
+	"go.uber.org/zap"
+
+	"github.com/omriharel/deej/pkg/deej/util"
+)
+
+func newTestShellWorkerPool(tb testing.TB) *shellWorkerPool {
+	if !util.Linux() {
+		tb.Skip("shell worker tests run bash")
+	}
+
+	if _, err := exec.LookPath("/bin/bash"); err != nil {
+		tb.Skip("bash not available")
+	}
+
+	pool := newShellWorkerPool(zap.NewNop().Sugar())
+	tb.Cleanup(pool.stop)
+
+	return pool
+}
+
+func TestShellWorkerIsolatesCommands(t *testing.T) {
+	pool := newTestShellWorkerPool(t)
+
+	// a command that reads stdin must see EOF, not the commands queued up behind it
+	if output, err := pool.run("read -r line; echo \"read: $line\""); err != nil || output != "read: " {
+		t.Fatalf("reading stdin: got %q, %v", output, err)
+	}
+
+	if _, err := pool.run("cd /; DEEJ_TEST_VAR=leaked; set -e"); err != nil {
+		t.Fatalf("changing shell state: %v", err)
+	}
+
+	wd, err := os.Getwd()
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	output, err := pool.run("echo \"[$DEEJ_TEST_VAR]\"; pwd; false; echo still running")
+	if want := "[]\n" + wd + "\nstill running"; err != nil || output != want {
+		t.Fatalf("shell state leaked between commands: got %q, %v, want %q", output, err, want)
+	}
+}
+
+// BenchmarkShellSpawn is what a shell command costs without the persistent executor: a fresh bash for every command
+func BenchmarkShellSpawn(b *testing.B) {
+	newTestShellWorkerPool(b)
+	b.ReportAllocs()
+
+	for i := 0; i < b.N; i++ {
+		if err := exec.Command("/bin/bash", "-c", "true").Run(); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
+
+// BenchmarkShellWorker runs the same command on a warm shell worker
+func BenchmarkShellWorker(b *testing.B) {
+	pool := newTestShellWorkerPool(b)
+	pool.warmUp()
+	b.ReportAllocs()
+	b.ResetTimer()
+
+	for i := 0; i < b.N; i++ {
+		if _, err := pool.run("true"); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
+
+// BenchmarkShellWorkerParallel runs commands from several goroutines at once, like button groups do
+func BenchmarkShellWorkerParallel(b *testing.B) {
+	pool := newTestShellWorkerPool(b)
+	b.ReportAllocs()
+
+	b.RunParallel(func(pb *testing.PB) {
+		for pb.Next() {
+			if _, err := pool.run("true"); err != nil {
+				b.Fatal(err)
+			}
+		}
+	})
+}
@@ -3,20 +3,19 @@ package deej
 import (
 	"fmt"
 	"strconv"
-	"sync"
 
 	"github.com/thoas/go-funk"
 )
 
+// sliderMap maps slider indices to their targets. it's only set up while building a config snapshot,
+// and never changes once the snapshot is published - so reading it takes no lock
 type sliderMap struct {
-	m    map[int][]string
-	lock sync.Locker
+	m map[int][]string
 }
 
 func newSliderMap() *sliderMap {
 	return &sliderMap{
-		m:    make(map[int][]string),
-		lock: &sync.Mutex{},
+		m: make(map[int][]string),
 	}
 }
 
@@ -53,33 +52,21 @@ func sliderMapFromConfigs(userMapping map[string][]string, internalMapping map[s
 }
 
 func (m *sliderMap) iterate(f func(int, []string)) {
-	m.lock.Lock()
-	defer m.lock.Unlock()
-
 	for key, value := range m.m {
 		f(key, value)
 	}
 }
 
 func (m *sliderMap) get(key int) ([]string, bool) {
-	m.lock.Lock()
-	defer m.lock.Unlock()
-
 	value, ok := m.m[key]
 	return value, ok
 }
 
 func (m *sliderMap) set(key int, value []string) {
-	m.lock.Lock()
-	defer m.lock.Unlock()
-
 	m.m[key] = value
 }
 
 func (m *sliderMap) String() string {
-	m.lock.Lock()
-	defer m.lock.Unlock()
-
 	sliderCount := 0
 	targetCount := 0
 
@@ -1,9 +1,140 @@
 package util
 
 import (
+	"bufio"
 	"errors"
+	"io/ioutil"
+	"os"
+	"os/exec"
+	"path/filepath"
+	"strconv"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"time"
+)
+
+const (
+
+	// how long to wait before re-subscribing to active window changes if xprop exits
+	activeWindowTrackerRetryDelay = 5 * time.Second
+)
+
+var (
+	errActiveWindowUnavailable = errors.New("Active window tracking unavailable")
+
+	activeWindowTrackerOnce sync.Once
+
+	// holds a []string of lowercase, de-duplicated process names owning the active window, or a nil []string
+	// while nothing tracks it. it's only ever replaced as a whole, so readers never need a lock
+	activeWindowProcessNames atomic.Value
 )
 
 func getCurrentWindowProcessNames() ([]string, error) {
-	return nil, errors.New("Not implemented")
+	activeWindowTrackerOnce.Do(func() {
+		go trackActiveWindow()
+	})
+
+	names, ok := activeWindowProcessNames.Load().([]string)
+	if !ok || names == nil {
+		return nil, errActiveWindowUnavailable
+	}
+
+	return names, nil
+}
+
+// trackActiveWindow subscribes to _NET_ACTIVE_WINDOW changes on the X11 root window (through xprop's spy mode),
+// and resolves the new window to its owning process once per change - instead of once per slider move
+func trackActiveWindow() {
+
+	// no X display (wayland-only or headless session), nothing to track
+	if os.Getenv("DISPLAY") == "" {
+		return
+	}
+
+	if _, err := exec.LookPath("xprop"); err != nil {
+		return
+	}
+
+	for {
+		spy := exec.Command("xprop", "-spy", "-root", "_NET_ACTIVE_WINDOW")
+
+		output, err := spy.StdoutPipe()
+		if err == nil {
+			err = spy.Start()
+		}
+
+		if err == nil {
+			scanner := bufio.NewScanner(output)
+			for scanner.Scan() {
+				activeWindowProcessNames.Store(resolveWindowProcessNames(scanner.Text()))
+			}
+
+			spy.Wait()
+		}
+
+		// until xprop is back, we can't tell which window is active anymore
+		activeWindowProcessNames.Store([]string(nil))
+
+		<-time.After(activeWindowTrackerRetryDelay)
+	}
+}
+
+// resolveWindowProcessNames takes a line such as "_NET_ACTIVE_WINDOW(WINDOW): window id # 0x3a00007"
+// (or "_NET_ACTIVE_WINDOW(CARDINAL) = 0x3a00007", when something other than a window manager set it)
+// and returns the name of the process that owns that window
+func resolveWindowProcessNames(line string) []string {
+	valueIdx := strings.LastIndex(line, "# ")
+	if valueIdx < 0 {
+		valueIdx = strings.LastIndex(line, "= ")
+	}
+
+	if valueIdx < 0 {
+		return []string{}
+	}
+
+	windowID := strings.TrimSpace(strings.SplitN(line[valueIdx+2:], ",", 2)[0])
+	if windowID == "" || windowID == "0x0" || windowID == "0" {
+		return []string{}
+	}
+
+	pidOutput, err := exec.Command("xprop", "-id", windowID, "_NET_WM_PID").Output()
+	if err != nil {
+		return []string{}
+	}
+
+	// "_NET_WM_PID(CARDINAL) = 1234"
+	equalsIdx := strings.LastIndex(string(pidOutput), "=")
+	if equalsIdx < 0 {
+		return []string{}
+	}
+
+	pid, err := strconv.Atoi(strings.TrimSpace(string(pidOutput)[equalsIdx+1:]))
+	if err != nil || pid <= 0 {
+		return []string{}
+	}
+
+	name := processNameForPID(pid)
+	if name == "" {
+		return []string{}
+	}
+
+	return []string{strings.ToLower(name)}
+}
+
+// processNameForPID prefers the executable's file name (which is what PulseAudio reports as
+// application.process.binary), falling back to the possibly truncated comm value
+func processNameForPID(pid int) string {
+	procPath := filepath.Join("/proc", strconv.Itoa(pid))
+
+	if exePath, err := os.Readlink(filepath.Join(procPath, "exe")); err == nil {
+		return filepath.Base(strings.TrimSuffix(exePath, " (deleted)"))
+	}
+
+	comm, err := ioutil.ReadFile(filepath.Join(procPath, "comm"))
+	if err != nil {
+		return ""
+	}
+
+	return strings.TrimSpace(string(comm))
 }
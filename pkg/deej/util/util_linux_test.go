@@ -0,0 +1,132 @@
+package util
+
+import (
+	"os"
+	"os/exec"
+	"path/filepath"
+	"strconv"
+	"strings"
+	"testing"
+	"time"
+)
+
+const testWindowTitle = "deej-active-window-test"
+
+// startTestWindow opens a small X client's window, and returns the client and the window's id
+func startTestWindow(t *testing.T) (*exec.Cmd, string) {
+	candidates := [][]string{
+		{"xmessage", "-title", testWindowTitle, "deej"},
+		{"xeyes", "-title", testWindowTitle},
+		{"xclock", "-title", testWindowTitle},
+		{"xterm", "-title", testWindowTitle},
+	}
+
+	var client *exec.Cmd
+	for _, args := range candidates {
+		if _, err := exec.LookPath(args[0]); err != nil {
+			continue
+		}
+
+		client = exec.Command(args[0], args[1:]...)
+		if err := client.Start(); err != nil {
+			t.Fatalf("start %s: %v", args[0], err)
+		}
+
+		break
+	}
+
+	if client == nil {
+		t.Skip("no X client to open a window with (xmessage, xeyes, xclock or xterm)")
+	}
+
+	t.Cleanup(func() {
+		client.Process.Kill()
+		client.Wait()
+	})
+
+	// "xwininfo: Window id: 0x1a00003 "deej-active-window-test""
+	deadline := time.Now().Add(5 * time.Second)
+	for time.Now().Before(deadline) {
+		output, err := exec.Command("xwininfo", "-name", testWindowTitle).Output()
+		if fields := strings.Fields(string(output)); err == nil {
+			for idx, field := range fields {
+				if field == "id:" && idx+1 < len(fields) {
+					return client, fields[idx+1]
+				}
+			}
+		}
+
+		time.Sleep(50 * time.Millisecond)
+	}
+
+	t.Fatal("test window never showed up")
+	return nil, ""
+}
+
+func setActiveWindow(t *testing.T, windowID string) {
+	if err := exec.Command("xprop", "-root", "-f", "_NET_ACTIVE_WINDOW", "32x",
+		"-set", "_NET_ACTIVE_WINDOW", windowID).Run(); err != nil {
+		t.Fatalf("set _NET_ACTIVE_WINDOW: %v", err)
+	}
+}
+
+func waitForWindowProcessNames(t *testing.T, expected []string) {
+	var names []string
+	var err error
+
+	deadline := time.Now().Add(5 * time.Second)
+	for time.Now().Before(deadline) {
+		names, err = GetCurrentWindowProcessNames()
+		if err == nil && strings.Join(names, ",") == strings.Join(expected, ",") {
+			return
+		}
+
+		time.Sleep(50 * time.Millisecond)
+	}
+
+	t.Fatalf("active window's processes are %v (error %v), want %v", names, err, expected)
+}
+
+// TestActiveWindowTracking runs against a bare X server such as Xvfb (DISPLAY=:99 after Xvfb :99). without a window
+// manager nothing sets _NET_ACTIVE_WINDOW, so the test sets it like one would
+func TestActiveWindowTracking(t *testing.T) {
+	if os.Getenv("DISPLAY") == "" {
+		t.Skip("no X display")
+	}
+
+	for _, tool := range []string{"xprop", "xwininfo"} {
+		if _, err := exec.LookPath(tool); err != nil {
+			t.Skipf("%s not available", tool)
+		}
+	}
+
+	if output, err := exec.Command("xprop", "-root", "_NET_ACTIVE_WINDOW").Output(); err != nil {
+		t.Skipf("can't reach the X display: %v", err)
+	} else if strings.Contains(string(output), "# ") {
+		t.Skip("a window manager owns _NET_ACTIVE_WINDOW on this display, run this under Xvfb instead")
+	}
+
+	client, windowID := startTestWindow(t)
+
+	// not every client sets its own pid, the window manager relies on the ones that do
+	if err := exec.Command("xprop", "-id", windowID, "-f", "_NET_WM_PID", "32c",
+		"-set", "_NET_WM_PID", strconv.Itoa(client.Process.Pid)).Run(); err != nil {
+		t.Fatalf("set _NET_WM_PID: %v", err)
+	}
+
+	exePath, err := os.Readlink(filepath.Join("/proc", strconv.Itoa(client.Process.Pid), "exe"))
+	if err != nil {
+		t.Fatalf("read test window's executable: %v", err)
+	}
+
+	t.Cleanup(func() {
+		exec.Command("xprop", "-root", "-remove", "_NET_ACTIVE_WINDOW").Run()
+	})
+
+	setActiveWindow(t, windowID)
+	waitForWindowProcessNames(t, []string{strings.ToLower(filepath.Base(exePath))})
+
+	// no active window, nothing to target
+	setActiveWindow(t, "0x0")
+	waitForWindowProcessNames(t, []string{})
+}
@@ -0,0 +1,21 @@
+package util
+
+import (
+	"testing"
+)
+
+func BenchmarkSignificantlyDifferent(b *testing.B) {
+	b.ReportAllocs()
+
+	for i := 0; i < b.N; i++ {
+		SignificantlyDifferent(float32(i&1), 0.5, "default")
+	}
+}
+
+func BenchmarkNormalizeScalar(b *testing.B) {
+	b.ReportAllocs()
+
+	for i := 0; i < b.N; i++ {
+		NormalizeScalar(float32(i&1023) / 1023.0)
+	}
+}